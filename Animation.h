@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+
+// Tile animation timing
+#define TILE_SLIDE_USEC 100000      // Tiles travel from source to destination
+#define TILE_POP_USEC 100000        // Merged tiles pulse and new tiles grow in
+#define TILE_ANIM_USEC (TILE_SLIDE_USEC + TILE_POP_USEC)
+
+#define MAX_TILE_MOTIONS 16
+
+// Where one tile came from and went to during a move, in board coordinates
+struct TileMotion {
+    int8_t fromRow;
+    int8_t fromCol;
+    int8_t toRow;
+    int8_t toCol;
+    int value;          // Value before any merge
+    bool merged;        // This tile merged into the one at its destination
+};
+
+// Everything the renderer needs to animate the most recent move
+struct BoardMove {
+    TileMotion motions[MAX_TILE_MOTIONS];
+    int motionCount;
+    int spawnRow;       // Tile added after the move, -1 if none
+    int spawnCol;
+    uint64_t startTime;
+    unsigned int id;    // Never repeats within a session, new games keep counting
+};
+
+// 0..1 progress of a phase that starts at start and lasts duration
+static inline float AnimationProgress(uint64_t now, uint64_t start, uint64_t duration) {
+    if (now <= start) return 0.0f;
+    if (now >= start + duration) return 1.0f;
+    return (float)(now - start) / (float)duration;
+}
+
+static inline float EaseOutQuad(float t) {
+    return 1.0f - (1.0f - t) * (1.0f - t);
+}
@@ -3,15 +3,28 @@
 #include "SaveData.h"
 #include "Renderer.h"
 #include "Input.h"
+#include "Timer.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include <stddef.h>
 #include <cmath>
 
+// Display resolution (720p, 1080p or 2160p), the scene is drawn at FRAME / RENDER_SCALE
+// and integer-upscaled on the way out
 #define FRAME_WIDTH 1920
 #define FRAME_HEIGHT 1080
+#define RENDER_SCALE 1
 #define FRAME_DEPTH 4
+#define FRAME_BUFFERS 3
+#define RASTER_THREADS 4
+
+// Offscreen surfaces: three full-screen layers plus tile sprites, at the drawing resolution
+#define SURFACE_MEM_SIZE (4 * (FRAME_WIDTH / RENDER_SCALE) * (FRAME_HEIGHT / RENDER_SCALE) * FRAME_DEPTH)
+
+// Flip pacing target, 20/30/60 Hz (120 Hz isn't available from the PS4 video out)
+#define TARGET_FRAME_RATE 60
 
 App::App() {
     scene = nullptr;
@@ -27,28 +40,58 @@ App::App() {
     currentState = STATE_MENU;
     menuSelection = 0;
     settingsSelection = 0;
+    theme = 0;
     
-    analogInputCooldown = 0;
+    analogReadyTime = 0;
     
     lastTouchX = -1;
     lastTouchY = -1;
     lastTouchActive = false;
     
-    lastUpPressed = false;
-    lastDownPressed = false;
-    lastLeftPressed = false;
-    lastRightPressed = false;
-    lastOptionsPressed = false;
-    lastXPressed = false;
-    lastTrianglePressed = false;
-    lastCirclePressed = false;
-    lastSquarePressed = false;
+    showProfiler = false;
+    screenshotID = 0;
+    capturedScreenshotID = 0;
+    recording = false;
     
     memset(grid, 0, sizeof(grid));
+    
+    memset(&lastMove, 0, sizeof(lastMove));
+    memset(&currentMove, 0, sizeof(currentMove));
+    lastMove.spawnRow = -1;
+    moveQueueCount = 0;
+    
+    memset(&lastPublished, 0, sizeof(lastPublished));
+    presentHead = 0;
+    presentCount = 0;
+    presentQuit = false;
+    pthread_mutex_init(&presentMutex, nullptr);
+    pthread_cond_init(&presentCond, nullptr);
+    
+    lastInputTime = 0;
+    lastIdleUpdate = 0;
+    idle = false;
+    pthread_mutex_init(&changeMutex, nullptr);
+    pthread_cond_init(&changeCond, nullptr);
+    publishedChange = 0;
+    renderedChange = 0;
+    
+    logicTicks = 0;
+    presentedFrames = 0;
+    skippedFrames = 0;
+    latencySamples = 0;
+    latencyTotal = 0;
+    latencyMax = 0;
+    lastMeasuredChange = 0;
+    lastReportTime = 0;
 }
 
 App::~App() {
     Shutdown();
+    
+    pthread_cond_destroy(&presentCond);
+    pthread_mutex_destroy(&presentMutex);
+    pthread_cond_destroy(&changeCond);
+    pthread_mutex_destroy(&changeMutex);
 }
 
 bool App::Init() {
@@ -57,11 +100,43 @@ bool App::Init() {
     printf("Creating 2D scene\n");
     scene = new Scene2D(FRAME_WIDTH, FRAME_HEIGHT, FRAME_DEPTH);
     
-    if(!scene->Init(0xC000000, 2)) {
+    if(!scene->Init(0xC000000, FRAME_BUFFERS)) {
         printf("Failed to initialize 2D scene\n");
         return false;
     }
     
+    // Rasterise each frame in horizontal bands across a small worker pool
+    if(!scene->SetRasterThreads(RASTER_THREADS)) {
+        printf("Warning: Failed to start raster threads, rendering on the main thread\n");
+    }
+    
+    // Draw into cacheable memory, only changed bands are streamed to the write-combined frame buffers
+    if(!scene->SetCacheableBackBuffer(true)) {
+        printf("Warning: Failed to allocate a back buffer, drawing straight to display memory\n");
+    }
+    
+    if(!scene->SetRenderScale(RENDER_SCALE)) {
+        printf("Warning: Render scale %d not supported, drawing at native resolution\n", RENDER_SCALE);
+    }
+    
+    // Layers and tile sprites are cached here, without it every screen is drawn from scratch
+    if(!scene->InitSurfaceArena(SURFACE_MEM_SIZE)) {
+        printf("Warning: Failed to allocate surface memory, screens won't be cached\n");
+    }
+    
+    if(!scene->SetTargetFrameRate(TARGET_FRAME_RATE)) {
+        printf("Warning: %d Hz pacing not supported, flipping at %d Hz\n", TARGET_FRAME_RATE, scene->GetTargetFrameRate());
+    }
+    
+    // Staging buffers are allocated now so a capture never allocates mid-frame
+    if(!screenshot.Init(scene)) {
+        printf("Warning: Failed to set up screenshots\n");
+    }
+    
+    if(!recorder.Init(scene)) {
+        printf("Warning: Failed to set up recording\n");
+    }
+    
     printf("Initializing controller\n");
     controller = new Controller();
     
@@ -74,7 +149,7 @@ bool App::Init() {
     Input::Init(controller);
     
     // Initialize renderer
-    Renderer::Init();
+    Renderer::Init(scene);
     
     // Initialize audio
     printf("Initializing audio\n");
@@ -85,10 +160,15 @@ bool App::Init() {
     // Load save data
     printf("Loading save data\n");
     int loadedVolume = 100;
-    if (SaveData::Load(highScore, loadedVolume)) {
+    if (SaveData::Load(highScore, loadedVolume, theme)) {
         Audio::SetVolume(loadedVolume);
     }
     
+    // Themes may have been removed from the file since the save was written
+    if (theme < 0 || theme >= Renderer::GetThemeCount()) {
+        theme = 0;
+    }
+    
     printf("Initialization complete\n");
     running = true;
     return true;
@@ -97,21 +177,286 @@ bool App::Init() {
 void App::Run() {
     printf("Starting game loop\n");
     
+    // Make sure the renderer has a valid snapshot before the logic thread starts
+    publishSnapshot(GetTimeUsec());
+    snapshots.Acquire();
+    
+    presentQuit = false;
+    lastReportTime = GetTimeUsec();
+    scene->SetThreadedPresent(true);
+    
+    if (pthread_create(&logicThreadHandle, nullptr, logicThread, this) != 0) {
+        printf("[ERROR] Failed to create logic thread\n");
+        return;
+    }
+    
+    if (pthread_create(&presentThreadHandle, nullptr, presentThread, this) != 0) {
+        printf("[ERROR] Failed to create present thread\n");
+        running = false;
+        pthread_join(logicThreadHandle, nullptr);
+        return;
+    }
+    
+    // This thread renders the newest snapshot, the swap only waits when no buffer is free
     while (running) {
-        update();
-        render();
+        snapshots.Acquire();
+        const GameSnapshot& snap = snapshots.ReadBuffer();
+        
+        // An edited theme file redraws the current screen even if nothing else changed
+        bool themeReloaded = Renderer::ReloadThemes(scene, GetTimeUsec());
+        
+        // An identical frame is neither drawn nor flipped, the last one stays on screen
+        if (!themeReloaded && !needsRender(snap, GetTimeUsec())) {
+            skippedFrames++;
+            scene->SkipFrame();
+            waitForChange();
+            continue;
+        }
+        renderedChange = snap.changeTime;
+        
+        {
+            ProfileScope scope(&profiler, PHASE_RENDER);
+            render(snap);
+        }
+        
+        PresentRequest request;
+        {
+            ProfileScope scope(&profiler, PHASE_RESOLVE);
+            request.bufferIndex = scene->QueueFrame(frameID);
+        }
+        request.frameID = frameID;
+        request.changeTime = snap.changeTime;
+        queuePresent(request);
+        
+        // Copied after the frame is handed over so its flip isn't delayed, but before the
+        // swap while it is still the active one
+        if (snap.screenshotID != capturedScreenshotID) {
+            capturedScreenshotID = snap.screenshotID;
+            screenshot.Capture(scene);
+        }
+        
+        if (snap.recording != recorder.IsRecording()) {
+            if (snap.recording) {
+                recorder.Start();
+            } else {
+                recorder.Stop();
+            }
+        }
+        if (recorder.IsRecording()) {
+            ProfileScope scope(&profiler, PHASE_RECORD);
+            recorder.CaptureFrame(scene, frameID);
+        }
         
-        scene->SubmitFlip(frameID);
-        scene->FrameWait(frameID);
         scene->FrameBufferSwap();
         frameID++;
     }
+    
+    pthread_join(logicThreadHandle, nullptr);
+    
+    pthread_mutex_lock(&presentMutex);
+    presentQuit = true;
+    pthread_cond_signal(&presentCond);
+    pthread_mutex_unlock(&presentMutex);
+    pthread_join(presentThreadHandle, nullptr);
+    
+    scene->SetThreadedPresent(false);
+}
+
+void* App::logicThread(void* arg) {
+    App* app = (App*)arg;
+    uint64_t nextTick = GetTimeUsec();
+    
+    while (app->running) {
+        uint64_t tickTime = GetTimeUsec();
+        bool updated;
+        
+        {
+            ProfileScope scope(&app->profiler, PHASE_UPDATE);
+            updated = app->update();
+        }
+        if (updated) {
+            app->publishSnapshot(tickTime);
+            app->logicTicks++;
+        }
+        
+        // Fixed tick: sleep to the next deadline, or catch up without sleeping if we fell behind
+        nextTick += LOGIC_TICK_USEC;
+        uint64_t now = GetTimeUsec();
+        
+        if (nextTick > now) {
+            SleepUsec((unsigned int)(nextTick - now));
+        } else {
+            nextTick = now;
+        }
+    }
+    
+    return nullptr;
+}
+
+void* App::presentThread(void* arg) {
+    App* app = (App*)arg;
+    PresentRequest request;
+    
+    while (app->waitPresent(request)) {
+        {
+            ProfileScope scope(&app->profiler, PHASE_SUBMIT_FLIP);
+            app->scene->SubmitFlip(request.bufferIndex, request.frameID);
+        }
+        {
+            ProfileScope scope(&app->profiler, PHASE_FRAME_WAIT);
+            app->scene->FrameWait(request.frameID);
+        }
+        
+        uint64_t now = GetTimeUsec();
+        app->profiler.FramePresented(now);
+        app->recordPresented(request, now);
+    }
+    
+    return nullptr;
+}
+
+void App::publishSnapshot(uint64_t tickTime) {
+    GameSnapshot& snap = snapshots.WriteBuffer();
+    
+    // Clear padding too, snapshots are compared bytewise below
+    memset(&snap, 0, sizeof(snap));
+    snap.state = currentState;
+    memcpy(snap.grid, grid, sizeof(grid));
+    snap.score = score;
+    snap.highScore = highScore;
+    snap.hasWon = hasWon;
+    snap.menuSelection = menuSelection;
+    snap.settingsSelection = settingsSelection;
+    snap.volume = Audio::GetVolume();
+    snap.theme = theme;
+    snap.move = lastMove;
+    snap.showProfiler = showProfiler;
+    snap.screenshotID = screenshotID;
+    snap.recording = recording;
+    
+    // Stamp the tick whenever something visible changed since the previous snapshot
+    snap.changeTime = lastPublished.changeTime;
+    
+    if (lastPublished.changeTime == 0 || memcmp(&snap, &lastPublished, offsetof(GameSnapshot, changeTime)) != 0) {
+        snap.changeTime = tickTime;
+    }
+    
+    lastPublished = snap;
+    snapshots.Publish();
+    
+    if (snap.changeTime == tickTime) {
+        pthread_mutex_lock(&changeMutex);
+        publishedChange = tickTime;
+        pthread_cond_signal(&changeCond);
+        pthread_mutex_unlock(&changeMutex);
+    }
+}
+
+bool App::needsRender(const GameSnapshot& snap, uint64_t now) {
+    if (snap.changeTime != renderedChange) return true;
+    
+    // The overlay's numbers change on their own
+    if (snap.showProfiler) return true;
+    
+    return snap.state == STATE_PLAYING && Renderer::IsAnimating(&snap.move, now);
+}
+
+void App::waitForChange() {
+    pthread_mutex_lock(&changeMutex);
+    
+    if (publishedChange == renderedChange) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += RENDER_WAIT_USEC * 1000;
+        if (deadline.tv_nsec >= 1000000000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000;
+        }
+        pthread_cond_timedwait(&changeCond, &changeMutex, &deadline);
+    }
+    
+    pthread_mutex_unlock(&changeMutex);
+}
+
+void App::queuePresent(const PresentRequest& request) {
+    pthread_mutex_lock(&presentMutex);
+    presentQueue[(presentHead + presentCount) % PRESENT_QUEUE_SIZE] = request;
+    presentCount++;
+    pthread_cond_signal(&presentCond);
+    pthread_mutex_unlock(&presentMutex);
+}
+
+bool App::waitPresent(PresentRequest& request) {
+    pthread_mutex_lock(&presentMutex);
+    
+    while (presentCount == 0 && !presentQuit) {
+        pthread_cond_wait(&presentCond, &presentMutex);
+    }
+    
+    // Drain queued frames before honouring a quit request
+    if (presentCount == 0) {
+        pthread_mutex_unlock(&presentMutex);
+        return false;
+    }
+    
+    request = presentQueue[presentHead];
+    presentHead = (presentHead + 1) % PRESENT_QUEUE_SIZE;
+    presentCount--;
+    pthread_mutex_unlock(&presentMutex);
+    return true;
+}
+
+void App::recordPresented(const PresentRequest& request, uint64_t now) {
+    presentedFrames++;
+    
+    // Input-to-photon: first frame showing a given state change reached the screen
+    if (request.changeTime != lastMeasuredChange) {
+        uint64_t latency = now - request.changeTime;
+        latencyTotal += latency;
+        latencySamples++;
+        if (latency > latencyMax) latencyMax = latency;
+        lastMeasuredChange = request.changeTime;
+    }
+    
+    uint64_t elapsed = now - lastReportTime;
+    if (elapsed < PIPELINE_REPORT_USEC) return;
+    
+    unsigned int ticks = logicTicks.exchange(0);
+    unsigned int skipped = skippedFrames.exchange(0);
+    printf("[PERF] logic %.1f Hz%s, present %.1f fps (%u skips), frame %.2f ms (target %d Hz, %d missed vsyncs), input-to-photon avg %.2f ms max %.2f ms (%u samples), flip stalls %d, last resolve %d bands %u us\n",
+           ticks * 1000000.0 / elapsed,
+           idle ? " idle" : "",
+           presentedFrames * 1000000.0 / elapsed,
+           skipped,
+           scene->GetFrameTimeUsec() / 1000.0,
+           scene->GetTargetFrameRate(),
+           scene->GetMissedVsyncCount(),
+           latencySamples ? latencyTotal / 1000.0 / latencySamples : 0.0,
+           latencyMax / 1000.0,
+           latencySamples,
+           scene->GetFlipStallCount(),
+           scene->GetResolvedBandCount(),
+           scene->GetResolveUsec());
+    
+    if (recorder.IsRecording()) {
+        RecorderStats rec = recorder.GetStats();
+        printf("[PERF] recording %u captured, %u dropped, %u encoded, %.1f MB written\n",
+               rec.captured, rec.dropped, rec.encoded, rec.bytesWritten / (1024.0 * 1024.0));
+    }
+    
+    presentedFrames = 0;
+    latencySamples = 0;
+    latencyTotal = 0;
+    latencyMax = 0;
+    lastReportTime = now;
 }
 
 void App::Shutdown() {
     printf("Shutting down\n");
     
     Audio::Shutdown();
+    screenshot.Shutdown();
+    recorder.Shutdown();
     
     if (controller) {
         delete controller;
@@ -124,10 +469,32 @@ void App::Shutdown() {
     }
 }
 
-void App::update() {
-    // Decrease analog cooldown
-    if (analogInputCooldown > 0) {
-        analogInputCooldown--;
+bool App::update() {
+    uint64_t now = GetTimeUsec();
+    
+    // The one pad read this tick, every input query below answers from it
+    controller->Update();
+    
+    if (lastInputTime == 0 || controller->HasInput(ANALOG_DEADZONE)) {
+        lastInputTime = now;
+    }
+    idle = (now - lastInputTime) >= IDLE_TIMEOUT_USEC;
+    
+    // Any press counts as input and clears idle above, so the ticks skipped here hold no
+    // button edges for the handlers below
+    if (idle && now - lastIdleUpdate < IDLE_TICK_USEC) return false;
+    lastIdleUpdate = now;
+    
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_R3)) {
+        showProfiler = !showProfiler;
+    }
+    
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_L1)) {
+        screenshotID++;
+    }
+    
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_R1)) {
+        recording = !recording;
     }
     
     switch (currentState) {
@@ -144,40 +511,47 @@ void App::update() {
             handleGameOverInput();
             break;
     }
+    
+    return true;
 }
 
-void App::render() {
-    switch (currentState) {
+void App::render(const GameSnapshot& snap) {
+    // Runs on the render thread, so it only reads the snapshot, never live game state
+    Renderer::SetTheme(scene, snap.theme);
+    
+    switch (snap.state) {
         case STATE_MENU:
-            Renderer::DrawMenu(scene, menuSelection, highScore);
+            Renderer::DrawMenu(scene, snap.menuSelection, snap.highScore);
             break;
         case STATE_SETTINGS:
-            Renderer::DrawSettings(scene, settingsSelection, Audio::GetVolume());
+            Renderer::DrawSettings(scene, snap.settingsSelection, snap.volume, snap.theme);
             break;
         case STATE_PLAYING:
-            Renderer::DrawGame(scene, grid, score);
+            Renderer::DrawGame(scene, snap.grid, snap.score, &snap.move, GetTimeUsec());
             break;
         case STATE_GAME_OVER:
-            Renderer::DrawGameOver(scene, score, highScore, hasWon);
+            Renderer::DrawGameOver(scene, snap.grid, snap.score, snap.highScore, snap.hasWon);
             break;
     }
+    
+    if (snap.showProfiler) {
+        Renderer::DrawProfiler(scene, profiler.GetStats(GetTimeUsec()));
+    }
+    
+    // Rasterise the recorded frame, all bands are done before we flip
+    scene->FlushDrawList();
 }
 
 void App::handleMenuInput() {
-    bool upPressed = controller->DpadUpPressed();
-    if (upPressed && !lastUpPressed) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_UP)) {
         menuSelection = (menuSelection - 1 + 2) % 2;
     }
-    lastUpPressed = upPressed;
     
-    bool downPressed = controller->DpadDownPressed();
-    if (downPressed && !lastDownPressed) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_DOWN)) {
         menuSelection = (menuSelection + 1) % 2;
     }
-    lastDownPressed = downPressed;
     
-    bool xPressed = controller->XPressed();
-    if (xPressed && !lastXPressed) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_CROSS)) {
         if (menuSelection == 0) {
             currentState = STATE_PLAYING;
             initGrid();
@@ -188,91 +562,88 @@ void App::handleMenuInput() {
             settingsSelection = 0;
         }
     }
-    lastXPressed = xPressed;
     
-    bool squarePressed = controller->SquarePressed();
-    if (squarePressed && !lastSquarePressed) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_SQUARE)) {
         running = false;
     }
-    lastSquarePressed = squarePressed;
 }
 
 void App::handleSettingsInput() {
-    bool upPressed = controller->DpadUpPressed();
-    if (upPressed && !lastUpPressed) {
-        settingsSelection = (settingsSelection - 1 + 2) % 2;
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_UP)) {
+        settingsSelection = (settingsSelection - 1 + 3) % 3;
     }
-    lastUpPressed = upPressed;
     
-    bool downPressed = controller->DpadDownPressed();
-    if (downPressed && !lastDownPressed) {
-        settingsSelection = (settingsSelection + 1) % 2;
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_DOWN)) {
+        settingsSelection = (settingsSelection + 1) % 3;
     }
-    lastDownPressed = downPressed;
     
-    bool leftPressed = controller->DpadLeftPressed();
-    if (leftPressed && !lastLeftPressed && settingsSelection == 0) {
-        int volume = Audio::GetVolume();
-        Audio::SetVolume(volume - 5);
+    // The renderer picks up theme changes from the next snapshot
+    int themeCount = Renderer::GetThemeCount();
+    
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_LEFT)) {
+        if (settingsSelection == 0) {
+            int volume = Audio::GetVolume();
+            Audio::SetVolume(volume - 5);
+        } else if (settingsSelection == 1) {
+            theme = (theme - 1 + themeCount) % themeCount;
+        }
     }
-    lastLeftPressed = leftPressed;
     
-    bool rightPressed = controller->DpadRightPressed();
-    if (rightPressed && !lastRightPressed && settingsSelection == 0) {
-        int volume = Audio::GetVolume();
-        Audio::SetVolume(volume + 5);
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_RIGHT)) {
+        if (settingsSelection == 0) {
+            int volume = Audio::GetVolume();
+            Audio::SetVolume(volume + 5);
+        } else if (settingsSelection == 1) {
+            theme = (theme + 1) % themeCount;
+        }
     }
-    lastRightPressed = rightPressed;
     
-    bool xPressed = controller->XPressed();
-    if (xPressed && !lastXPressed) {
-        if (settingsSelection == 1) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_CROSS)) {
+        if (settingsSelection == 2) {
             currentState = STATE_MENU;
             menuSelection = 0;
-            SaveData::Save(highScore, Audio::GetVolume());
+            SaveData::Save(highScore, Audio::GetVolume(), theme);
         }
     }
-    lastXPressed = xPressed;
     
-    bool circlePressed = controller->CirclePressed();
-    if (circlePressed && !lastCirclePressed) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_CIRCLE)) {
         currentState = STATE_MENU;
         menuSelection = 0;
-        SaveData::Save(highScore, Audio::GetVolume());
+        SaveData::Save(highScore, Audio::GetVolume(), theme);
     }
-    lastCirclePressed = circlePressed;
 }
 
 void App::handleGameInput() {
     if (gameOver) return;
     
     bool moved = false;
-    Direction dir = Input::GetDirectionInput(analogInputCooldown);
+    Direction dir = Input::GetDirectionInput(analogReadyTime, GetTimeUsec());
     
-    switch (dir) {
-        case DIR_UP:    moved = moveUp(); break;
-        case DIR_DOWN:  moved = moveDown(); break;
-        case DIR_LEFT:  moved = moveLeft(); break;
-        case DIR_RIGHT: moved = moveRight(); break;
-        default: break;
+    if (dir != DIR_NONE && moveQueueCount < MOVE_QUEUE_SIZE) {
+        moveQueue[moveQueueCount++] = dir;
     }
     
-    bool optionsPressed = controller->StartPressed();
-    if (optionsPressed && !lastOptionsPressed) {
+    // Apply queued moves once the previous slide has finished
+    if (moveQueueCount > 0 && GetTimeUsec() >= lastMove.startTime + TILE_SLIDE_USEC) {
+        Direction next = moveQueue[0];
+        memmove(moveQueue, moveQueue + 1, (moveQueueCount - 1) * sizeof(Direction));
+        moveQueueCount--;
+        
+        moved = applyMove(next);
+    }
+    
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_OPTIONS)) {
         initGrid();
         addRandomTile();
         addRandomTile();
         moved = false;
     }
-    lastOptionsPressed = optionsPressed;
     
-    bool xPressed = controller->XPressed();
-    if (xPressed && !lastXPressed) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_CROSS)) {
         currentState = STATE_MENU;
         gameOver = false;
         hasWon = false;
     }
-    lastXPressed = xPressed;
     
     if (moved) {
         addRandomTile();
@@ -280,7 +651,7 @@ void App::handleGameInput() {
             gameOver = true;
             if (score > highScore) {
                 highScore = score;
-                SaveData::Save(highScore, Audio::GetVolume());
+                SaveData::Save(highScore, Audio::GetVolume(), theme);
             }
             currentState = STATE_GAME_OVER;
         }
@@ -288,18 +659,13 @@ void App::handleGameInput() {
 }
 
 void App::handleGameOverInput() {
-    bool trianglePressed = controller->TrianglePressed();
-    bool circlePressed = controller->CirclePressed();
-    if ((trianglePressed && !lastTrianglePressed) || (circlePressed && !lastCirclePressed)) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_TRIANGLE | ORBIS_PAD_BUTTON_CIRCLE)) {
         currentState = STATE_MENU;
         gameOver = false;
         hasWon = false;
     }
-    lastTrianglePressed = trianglePressed;
-    lastCirclePressed = circlePressed;
     
-    bool optionsPressed = controller->StartPressed();
-    if (optionsPressed && !lastOptionsPressed) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_OPTIONS)) {
         currentState = STATE_PLAYING;
         initGrid();
         addRandomTile();
@@ -307,15 +673,12 @@ void App::handleGameOverInput() {
         gameOver = false;
         hasWon = false;
     }
-    lastOptionsPressed = optionsPressed;
     
-    bool xPressed = controller->XPressed();
-    if (xPressed && !lastXPressed) {
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_CROSS)) {
         currentState = STATE_MENU;
         gameOver = false;
         hasWon = false;
     }
-    lastXPressed = xPressed;
 }
 
 void App::initGrid() {
@@ -323,6 +686,36 @@ void App::initGrid() {
     score = 0;
     gameOver = false;
     hasWon = false;
+    
+    // A fresh board starts without an animation or pending moves. Move ids keep counting, the
+    // renderer bursts particles once per id and would skip a repeat from the previous game.
+    unsigned int moveID = lastMove.id;
+    memset(&lastMove, 0, sizeof(lastMove));
+    lastMove.spawnRow = -1;
+    lastMove.id = moveID;
+    moveQueueCount = 0;
+}
+
+bool App::applyMove(Direction dir) {
+    memset(&currentMove, 0, sizeof(currentMove));
+    
+    bool moved = false;
+    switch (dir) {
+        case DIR_UP:    moved = moveUp(); break;
+        case DIR_DOWN:  moved = moveDown(); break;
+        case DIR_LEFT:  moved = moveLeft(); break;
+        case DIR_RIGHT: moved = moveRight(); break;
+        default: break;
+    }
+    
+    if (moved) {
+        currentMove.spawnRow = -1;
+        currentMove.startTime = GetTimeUsec();
+        currentMove.id = lastMove.id + 1;
+        lastMove = currentMove;
+    }
+    
+    return moved;
 }
 
 bool App::addRandomTile() {
@@ -344,10 +737,39 @@ bool App::addRandomTile() {
     int index = rand() % emptyCount;
     int value = (rand() % 10 < 9) ? 2 : 4;
     grid[emptyCells[index][0]][emptyCells[index][1]] = value;
+    
+    lastMove.spawnRow = emptyCells[index][0];
+    lastMove.spawnCol = emptyCells[index][1];
     return true;
 }
 
-bool App::slideLeft() {
+void App::recordMotion(int rotations, int row, int fromCol, int toCol, int value, bool merged) {
+    if (currentMove.motionCount >= MAX_TILE_MOTIONS) return;
+    
+    TileMotion* motion = &currentMove.motions[currentMove.motionCount++];
+    int fromRow = row;
+    int toRow = row;
+    
+    // Undo the clockwise rotations the move was made under, so motions are in board coordinates
+    for (int k = 0; k < rotations; k++) {
+        int t = fromRow;
+        fromRow = GRID_SIZE - 1 - fromCol;
+        fromCol = t;
+        
+        t = toRow;
+        toRow = GRID_SIZE - 1 - toCol;
+        toCol = t;
+    }
+    
+    motion->fromRow = fromRow;
+    motion->fromCol = fromCol;
+    motion->toRow = toRow;
+    motion->toCol = toCol;
+    motion->value = value;
+    motion->merged = merged;
+}
+
+bool App::slideLeft(int rotations) {
     bool moved = false;
     
     for (int i = 0; i < GRID_SIZE; i++) {
@@ -357,6 +779,7 @@ bool App::slideLeft() {
         for (int j = 0; j < GRID_SIZE; j++) {
             if (grid[i][j] != 0) {
                 if (writePos > 0 && grid[i][writePos - 1] == grid[i][j] && !merged[writePos - 1]) {
+                    recordMotion(rotations, i, j, writePos - 1, grid[i][j], true);
                     grid[i][writePos - 1] *= 2;
                     score += grid[i][writePos - 1];
                     grid[i][j] = 0;
@@ -367,6 +790,7 @@ bool App::slideLeft() {
                         hasWon = true;
                     }
                 } else {
+                    recordMotion(rotations, i, j, writePos, grid[i][j], false);
                     if (writePos != j) {
                         grid[i][writePos] = grid[i][j];
                         grid[i][j] = 0;
@@ -394,13 +818,13 @@ void App::rotateClockwise() {
 }
 
 bool App::moveLeft() { 
-    return slideLeft(); 
+    return slideLeft(0); 
 }
 
 bool App::moveRight() { 
     rotateClockwise(); 
     rotateClockwise(); 
-    bool r = slideLeft(); 
+    bool r = slideLeft(2); 
     rotateClockwise(); 
     rotateClockwise(); 
     return r; 
@@ -410,14 +834,14 @@ bool App::moveUp() {
     rotateClockwise(); 
     rotateClockwise(); 
     rotateClockwise(); 
-    bool r = slideLeft(); 
+    bool r = slideLeft(3); 
     rotateClockwise(); 
     return r; 
 }
 
 bool App::moveDown() { 
     rotateClockwise(); 
-    bool r = slideLeft(); 
+    bool r = slideLeft(1); 
     rotateClockwise(); 
     rotateClockwise(); 
     rotateClockwise(); 
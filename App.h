@@ -1,11 +1,32 @@
 #pragma once
 
+#include <pthread.h>
+#include <atomic>
 #include "graphics.h"
 #include "controller.h"
+#include "Input.h"
+#include "Animation.h"
+#include "TripleBuffer.h"
+#include "Profiler.h"
+#include "Screenshot.h"
+#include "Recorder.h"
 
 // Game defines
 #define GRID_SIZE 4
 #define WIN_TILE 2048
+#define MOVE_QUEUE_SIZE 4           // Moves buffered while tiles are still sliding
+
+// Pipeline defines
+#define LOGIC_TICK_USEC 16667       // Fixed 60 Hz logic tick
+#define PRESENT_QUEUE_SIZE 4        // Must hold every frame buffer
+#define PIPELINE_REPORT_USEC 5000000
+
+// Idle power mode: without input for IDLE_TIMEOUT_USEC the game update and snapshot only run
+// every IDLE_TICK_USEC. The pad is still read every logic tick so a short tap wakes the unit.
+// The render thread only draws when a snapshot changed or something is animating.
+#define IDLE_TIMEOUT_USEC 30000000
+#define IDLE_TICK_USEC 100000
+#define RENDER_WAIT_USEC 100000     // Upper bound on a wait for changes, so shutdown is noticed
 
 // Game states
 enum GameState {
@@ -15,6 +36,33 @@ enum GameState {
     STATE_GAME_OVER
 };
 
+// Immutable copy of everything the renderer needs, published by the logic thread
+struct GameSnapshot {
+    GameState state;
+    int grid[GRID_SIZE][GRID_SIZE];
+    int score;
+    int highScore;
+    bool hasWon;
+    int menuSelection;
+    int settingsSelection;
+    int volume;
+    int theme;
+    BoardMove move;
+    bool showProfiler;
+    unsigned int screenshotID;  // Bumped for every capture request
+    bool recording;
+    
+    // Logic tick at which the visible state last changed, used for input-to-photon latency
+    uint64_t changeTime;
+};
+
+// A rendered frame waiting for the present thread
+struct PresentRequest {
+    int bufferIndex;
+    int frameID;
+    uint64_t changeTime;
+};
+
 class App {
 public:
     App();
@@ -36,20 +84,16 @@ private:
     GameState currentState;
     int menuSelection;
     int settingsSelection;
+    int theme;
     
-    // Input state
-    bool lastUpPressed;
-    bool lastDownPressed;
-    bool lastLeftPressed;
-    bool lastRightPressed;
-    bool lastOptionsPressed;
-    bool lastXPressed;
-    bool lastTrianglePressed;
-    bool lastCirclePressed;
-    bool lastSquarePressed;
+    // Animation state, moves made mid-slide are queued rather than dropped
+    BoardMove lastMove;
+    BoardMove currentMove;
+    Direction moveQueue[MOVE_QUEUE_SIZE];
+    int moveQueueCount;
     
     // Analog input timing
-    int analogInputCooldown;
+    uint64_t analogReadyTime;
     
     // Touchpad state
     int lastTouchX;
@@ -59,13 +103,71 @@ private:
     // Systems
     Scene2D* scene;
     Controller* controller;
-    bool running;
+    std::atomic<bool> running;
     int frameID;
     
+    // Pipeline: logic publishes snapshots, render consumes them, present flips
+    TripleBuffer<GameSnapshot> snapshots;
+    GameSnapshot lastPublished;
+    pthread_t logicThreadHandle;
+    pthread_t presentThreadHandle;
+    
+    pthread_mutex_t presentMutex;
+    pthread_cond_t presentCond;
+    PresentRequest presentQueue[PRESENT_QUEUE_SIZE];
+    int presentHead;
+    int presentCount;
+    bool presentQuit;
+    
+    // Idle detection on the logic thread
+    uint64_t lastInputTime;
+    uint64_t lastIdleUpdate;
+    std::atomic<bool> idle;
+    
+    // Render thread sleeps on this until the logic thread publishes a visible change
+    pthread_mutex_t changeMutex;
+    pthread_cond_t changeCond;
+    uint64_t publishedChange;
+    uint64_t renderedChange;
+    
+    // Frame profiler overlay, toggled with R3
+    Profiler profiler;
+    bool showProfiler;
+    
+    // Screenshots, requested with L1 on the logic thread and captured after the next render
+    Screenshot screenshot;
+    unsigned int screenshotID;
+    unsigned int capturedScreenshotID;
+    
+    // Session recording, toggled with R1. Frames are captured on the render thread.
+    Recorder recorder;
+    bool recording;
+    
+    // Pipeline stats
+    std::atomic<unsigned int> logicTicks;
+    unsigned int presentedFrames;
+    std::atomic<unsigned int> skippedFrames;
+    unsigned int latencySamples;
+    uint64_t latencyTotal;
+    uint64_t latencyMax;
+    uint64_t lastMeasuredChange;
+    uint64_t lastReportTime;
+    
+    static void* logicThread(void* arg);
+    static void* presentThread(void* arg);
+    void publishSnapshot(uint64_t tickTime);
+    bool needsRender(const GameSnapshot& snap, uint64_t now);
+    void waitForChange();
+    void queuePresent(const PresentRequest& request);
+    bool waitPresent(PresentRequest& request);
+    void recordPresented(const PresentRequest& request, uint64_t now);
+    
     // Game logic
     void initGrid();
     bool addRandomTile();
-    bool slideLeft();
+    bool slideLeft(int rotations);
+    void recordMotion(int rotations, int row, int fromCol, int toCol, int value, bool merged);
+    bool applyMove(Direction dir);
     void rotateClockwise();
     bool moveLeft();
     bool moveRight();
@@ -79,7 +181,7 @@ private:
     void handleGameInput();
     void handleGameOverInput();
     
-    // Update methods
-    void update();
-    void render();
+    // Update methods. update() returns false on the idle ticks that only read the pad.
+    bool update();
+    void render(const GameSnapshot& snap);
 };
@@ -0,0 +1,213 @@
+#include "Blend.h"
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Exact x / 255 for x in [0, 255 * 255]
+static inline uint32_t div255(uint32_t x) {
+    x += 128;
+    return (x + (x >> 8)) >> 8;
+}
+
+static inline uint32_t blendPixel(uint32_t dst, uint32_t src) {
+    uint32_t inv = 255 - (src >> 24);
+    
+    // Two channels per multiply, red/blue and alpha/green
+    uint32_t rb = (dst & 0x00FF00FF) * inv + 0x00800080;
+    uint32_t ag = ((dst >> 8) & 0x00FF00FF) * inv + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    
+    return src + (rb | ag);
+}
+
+// Scale all four premultiplied channels by coverage / 255
+static inline uint32_t scalePixel(uint32_t src, uint32_t coverage) {
+    uint32_t rb = (src & 0x00FF00FF) * coverage + 0x00800080;
+    uint32_t ag = ((src >> 8) & 0x00FF00FF) * coverage + 0x00800080;
+    rb = ((rb + ((rb >> 8) & 0x00FF00FF)) >> 8) & 0x00FF00FF;
+    ag = (ag + ((ag >> 8) & 0x00FF00FF)) & 0xFF00FF00;
+    
+    return rb | ag;
+}
+
+Pixel ScalePixel(Pixel src, uint32_t coverage) {
+    return scalePixel(src, coverage);
+}
+
+void BlendMaskSpan(uint32_t *dst, int count, Pixel src, const uint8_t *coverage, int step) {
+    // Masks only cover small areas such as rounded corners, so this stays scalar
+    for (int i = 0; i < count; i++, coverage += step) {
+        uint32_t c = *coverage;
+        
+        if (c == 0) continue;
+        dst[i] = blendPixel(dst[i], c == 255 ? src : scalePixel(src, c));
+    }
+}
+
+void BlendSpanScalar(uint32_t *dst, int count, Pixel src) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = blendPixel(dst[i], src);
+    }
+}
+
+void BlendRowScalar(uint32_t *dst, const uint32_t *src, int count) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = blendPixel(dst[i], src[i]);
+    }
+}
+
+void ColorKeyRowScalar(uint32_t *dst, const uint32_t *src, int count, Pixel key) {
+    for (int i = 0; i < count; i++) {
+        if (src[i] != key) dst[i] = src[i];
+    }
+}
+
+#if defined(__SSE2__)
+
+// Scale eight 16-bit channels by eight 16-bit factors and divide by 255
+static inline __m128i mulDiv255(__m128i channels, __m128i factors) {
+    __m128i x = _mm_add_epi16(_mm_mullo_epi16(channels, factors), _mm_set1_epi16(128));
+    return _mm_srli_epi16(_mm_add_epi16(x, _mm_srli_epi16(x, 8)), 8);
+}
+
+void BlendSpan(uint32_t *dst, int count, Pixel src) {
+    uint32_t alpha = src >> 24;
+    
+    if (alpha == 0) return;
+    if (alpha == 255) {
+        for (int i = 0; i < count; i++) dst[i] = src;
+        return;
+    }
+    
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i inv = _mm_set1_epi16((short)(255 - alpha));
+    const __m128i source = _mm_set1_epi32((int)src);
+    int i = 0;
+    
+    // Four pixels per iteration
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i lo = mulDiv255(_mm_unpacklo_epi8(d, zero), inv);
+        __m128i hi = mulDiv255(_mm_unpackhi_epi8(d, zero), inv);
+        __m128i out = _mm_add_epi8(_mm_packus_epi16(lo, hi), source);
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+    
+    for (; i < count; i++) {
+        dst[i] = blendPixel(dst[i], src);
+    }
+}
+
+void BlendRow(uint32_t *dst, const uint32_t *src, int count) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaMask = _mm_set1_epi32((int)0xFF000000);
+    const __m128i allOnes = _mm_set1_epi16(255);
+    int i = 0;
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i a = _mm_and_si128(s, alphaMask);
+        
+        // Opaque and fully transparent groups skip the arithmetic, that's most of a sprite
+        int opaque = _mm_movemask_epi8(_mm_cmpeq_epi32(a, alphaMask));
+        if (opaque == 0xFFFF) {
+            _mm_storeu_si128((__m128i *)(dst + i), s);
+            continue;
+        }
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(a, zero)) == 0xFFFF) continue;
+        
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        
+        // Broadcast each pixel's alpha over its four channels and invert it
+        __m128i slo = _mm_unpacklo_epi8(s, zero);
+        __m128i shi = _mm_unpackhi_epi8(s, zero);
+        __m128i alo = _mm_shufflehi_epi16(_mm_shufflelo_epi16(slo, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        __m128i ahi = _mm_shufflehi_epi16(_mm_shufflelo_epi16(shi, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+        
+        __m128i lo = mulDiv255(_mm_unpacklo_epi8(d, zero), _mm_sub_epi16(allOnes, alo));
+        __m128i hi = mulDiv255(_mm_unpackhi_epi8(d, zero), _mm_sub_epi16(allOnes, ahi));
+        __m128i out = _mm_add_epi8(_mm_packus_epi16(lo, hi), s);
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+    
+    for (; i < count; i++) {
+        dst[i] = blendPixel(dst[i], src[i]);
+    }
+}
+
+void CopyRow(uint32_t *dst, const uint32_t *src, int count) {
+    int i = 0;
+    
+    // Pixels up to the first 16-byte boundary of the destination
+    for (; i < count && ((uintptr_t)(dst + i) & 15) != 0; i++) {
+        dst[i] = src[i];
+    }
+    
+    // Surface rows start 64-byte aligned, so blits from a multiple of 4 pixels get aligned loads too
+    if (((uintptr_t)(src + i) & 15) == 0) {
+        for (; i + 8 <= count; i += 8) {
+            __m128i a = _mm_load_si128((const __m128i *)(src + i));
+            __m128i b = _mm_load_si128((const __m128i *)(src + i + 4));
+            _mm_store_si128((__m128i *)(dst + i), a);
+            _mm_store_si128((__m128i *)(dst + i + 4), b);
+        }
+    } else {
+        for (; i + 8 <= count; i += 8) {
+            __m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+            __m128i b = _mm_loadu_si128((const __m128i *)(src + i + 4));
+            _mm_store_si128((__m128i *)(dst + i), a);
+            _mm_store_si128((__m128i *)(dst + i + 4), b);
+        }
+    }
+    
+    for (; i < count; i++) {
+        dst[i] = src[i];
+    }
+}
+
+void ColorKeyRow(uint32_t *dst, const uint32_t *src, int count, Pixel key) {
+    const __m128i keys = _mm_set1_epi32((int)key);
+    int i = 0;
+    
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i keyed = _mm_cmpeq_epi32(s, keys);
+        int bits = _mm_movemask_epi8(keyed);
+        
+        // Runs of all-key or no-key pixels skip the select
+        if (bits == 0xFFFF) continue;
+        if (bits == 0) {
+            _mm_storeu_si128((__m128i *)(dst + i), s);
+            continue;
+        }
+        
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i out = _mm_or_si128(_mm_and_si128(keyed, d), _mm_andnot_si128(keyed, s));
+        _mm_storeu_si128((__m128i *)(dst + i), out);
+    }
+    
+    ColorKeyRowScalar(dst + i, src + i, count - i, key);
+}
+
+#else
+
+void BlendSpan(uint32_t *dst, int count, Pixel src) {
+    BlendSpanScalar(dst, count, src);
+}
+
+void BlendRow(uint32_t *dst, const uint32_t *src, int count) {
+    BlendRowScalar(dst, src, count);
+}
+
+void CopyRow(uint32_t *dst, const uint32_t *src, int count) {
+    memcpy(dst, src, count * sizeof(uint32_t));
+}
+
+void ColorKeyRow(uint32_t *dst, const uint32_t *src, int count, Pixel key) {
+    ColorKeyRowScalar(dst, src, count, key);
+}
+
+#endif
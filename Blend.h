@@ -0,0 +1,31 @@
+#pragma once
+
+#include <stdint.h>
+#include "graphics.h"
+
+// Premultiplied source-over: dst = src + dst * (255 - srcAlpha) / 255, on every channel.
+// Both supported pixel formats keep alpha in the top byte, so one routine serves both.
+
+// Blend one constant pixel over a span of count pixels
+void BlendSpan(uint32_t *dst, int count, Pixel src);
+
+// Blend a row of source pixels over a row of destination pixels
+void BlendRow(uint32_t *dst, const uint32_t *src, int count);
+
+// Blend one constant pixel over a span, scaled per pixel by an 8-bit coverage mask.
+// The mask is read with the given step so mirrored corners can share one mask.
+void BlendMaskSpan(uint32_t *dst, int count, Pixel src, const uint8_t *coverage, int step);
+
+// Scale all four premultiplied channels by coverage / 255, e.g. to fade a color out
+Pixel ScalePixel(Pixel src, uint32_t coverage);
+
+// Copy a row of pixels with 16-byte stores aligned on the destination
+void CopyRow(uint32_t *dst, const uint32_t *src, int count);
+
+// Copy a row of pixels, leaving the destination alone wherever the source equals key
+void ColorKeyRow(uint32_t *dst, const uint32_t *src, int count, Pixel key);
+
+// Straightforward per-pixel versions, the reference the vector paths must match
+void BlendSpanScalar(uint32_t *dst, int count, Pixel src);
+void BlendRowScalar(uint32_t *dst, const uint32_t *src, int count);
+void ColorKeyRowScalar(uint32_t *dst, const uint32_t *src, int count, Pixel key);
@@ -0,0 +1,464 @@
+#include "DisplayList.h"
+#include "Blend.h"
+#include <stdlib.h>
+#include <string.h>
+
+// Only draws at least this big are tracked as occluders of earlier draws
+#define OCCLUDER_MIN_AREA 1024
+#define MAX_OCCLUDERS 32
+
+// Widest sprite row that can be scaled and blended in one go
+#define MAX_BLEND_ROW 4096
+
+// Rects at least this big get the spans under later opaque draws cut out
+#define SPAN_SUBTRACT_MIN_AREA 4096
+
+// 64-bit FNV-1a
+#define HASH_OFFSET 0xCBF29CE484222325ULL
+#define HASH_PRIME 0x100000001B3ULL
+
+struct Occluder {
+    int order;
+    int x0, y0;
+    int x1, y1;
+};
+
+static inline void fillSpan(uint32_t *row, int x0, int x1, Pixel pixel) {
+    for (int x = x0; x < x1; x++) {
+        row[x] = pixel;
+    }
+}
+
+static void fillRect(uint32_t *target, int pitch, int x0, int y0, int x1, int y1, Pixel pixel) {
+    uint32_t *row = target + y0 * pitch;
+    
+    for (int y = y0; y < y1; y++) {
+        fillSpan(row, x0, x1, pixel);
+        row += pitch;
+    }
+}
+
+// Fill a rect, skipping the parts later opaque draws will overwrite anyway
+static void fillRectExcluding(uint32_t *target, int pitch, int x0, int y0, int x1, int y1, Pixel pixel,
+                              const Occluder *occluders, int numOccluders) {
+    uint32_t *row = target + y0 * pitch;
+    
+    for (int y = y0; y < y1; y++) {
+        int starts[MAX_OCCLUDERS];
+        int ends[MAX_OCCLUDERS];
+        int count = 0;
+        
+        // Insertion sort the covered intervals on this row by start
+        for (int i = 0; i < numOccluders; i++) {
+            const Occluder *o = &occluders[i];
+            if (y < o->y0 || y >= o->y1) continue;
+            
+            int j = count++;
+            while (j > 0 && starts[j - 1] > o->x0) {
+                starts[j] = starts[j - 1];
+                ends[j] = ends[j - 1];
+                j--;
+            }
+            starts[j] = o->x0;
+            ends[j] = o->x1;
+        }
+        
+        int x = x0;
+        for (int i = 0; i < count && x < x1; i++) {
+            if (starts[i] > x) fillSpan(row, x, starts[i] < x1 ? starts[i] : x1, pixel);
+            if (ends[i] > x) x = ends[i];
+        }
+        if (x < x1) fillSpan(row, x, x1, pixel);
+        
+        row += pitch;
+    }
+}
+
+static void drawGlyphRun(const GlyphRunCommand *cmd, uint32_t *target, int pitch, int bandY0, int bandY1) {
+    const BitmapFont *font = cmd->font;
+    int scale = cmd->scale;
+    int penX = cmd->penX;
+    int y = cmd->penY;
+    int clipX0 = cmd->header.x0;
+    int clipX1 = cmd->header.x1;
+    
+    for (int n = 0; n < cmd->length; n++, penX += font->advance * scale) {
+        const uint8_t *glyph = font->glyphs[cmd->text[n] & 0x7F];
+        if (!glyph) continue;
+        if (penX >= clipX1 || penX + font->glyphWidth * scale <= clipX0) continue;
+        
+        for (int r = 0; r < font->glyphHeight; r++) {
+            int gy0 = y + r * scale;
+            int gy1 = gy0 + scale;
+            if (gy0 < bandY0) gy0 = bandY0;
+            if (gy1 > bandY1) gy1 = bandY1;
+            if (gy0 >= gy1) continue;
+            
+            // Fill each horizontal run of lit cells as one span
+            uint8_t bits = glyph[r];
+            int col = 0;
+            while (col < font->glyphWidth) {
+                if (!(bits & (1 << (font->glyphWidth - 1 - col)))) {
+                    col++;
+                    continue;
+                }
+                
+                int runStart = col;
+                while (col < font->glyphWidth && (bits & (1 << (font->glyphWidth - 1 - col)))) col++;
+                
+                int sx0 = penX + runStart * scale;
+                int sx1 = penX + col * scale;
+                if (sx0 < clipX0) sx0 = clipX0;
+                if (sx1 > clipX1) sx1 = clipX1;
+                if (sx0 < sx1) fillRect(target, pitch, sx0, gy0, sx1, gy1, cmd->pixel);
+            }
+        }
+    }
+}
+
+static void drawSprite(const SpriteCommand *cmd, uint32_t *target, int pitch, int x0, int y0, int x1, int y1) {
+    int dstWidth = cmd->dstWidth;
+    int dstHeight = cmd->dstHeight;
+    uint32_t scaled[MAX_BLEND_ROW];
+    
+    if (x1 - x0 > MAX_BLEND_ROW) x1 = x0 + MAX_BLEND_ROW;
+    
+    for (int y = y0; y < y1; y++) {
+        int sy = (y - cmd->dstY) * cmd->srcHeight / dstHeight;
+        const uint32_t *src = cmd->pixels + sy * cmd->pitch + (x0 - cmd->dstX);
+        uint32_t *dst = target + y * pitch + x0;
+        
+        if (dstWidth != cmd->srcWidth) {
+            // Nearest neighbour scaling in 16.16 fixed point into a row buffer
+            uint32_t step = ((uint32_t)cmd->srcWidth << 16) / dstWidth;
+            uint32_t sx = (uint32_t)(x0 - cmd->dstX) * step;
+            const uint32_t *srcRow = cmd->pixels + sy * cmd->pitch;
+            
+            for (int x = 0; x < x1 - x0; x++, sx += step) {
+                scaled[x] = srcRow[sx >> 16];
+            }
+            src = scaled;
+        }
+        
+        switch (cmd->mode) {
+            case SPRITE_COPY:
+                CopyRow(dst, src, x1 - x0);
+                break;
+            case SPRITE_BLEND:
+                BlendRow(dst, src, x1 - x0);
+                break;
+            case SPRITE_COLOR_KEY:
+                ColorKeyRow(dst, src, x1 - x0, cmd->key);
+                break;
+        }
+    }
+}
+
+static void drawMask(const MaskCommand *cmd, uint32_t *target, int pitch, int x0, int y0, int x1, int y1) {
+    int w = cmd->width;
+    int h = cmd->height;
+    int mx = x0 - cmd->maskX;
+    int step = 1;
+    
+    if (cmd->flipX) {
+        mx = w - 1 - mx;
+        step = -1;
+    }
+    
+    for (int y = y0; y < y1; y++) {
+        int my = y - cmd->maskY;
+        if (cmd->flipY) my = h - 1 - my;
+        
+        BlendMaskSpan(target + y * pitch + x0, x1 - x0, cmd->pixel, cmd->mask + my * cmd->pitch + mx, step);
+    }
+}
+
+DisplayList::DisplayList(size_t size) {
+    arena = (uint8_t *)malloc(size);
+    arenaSize = arena ? size : 0;
+    SetClip(0, 0, 0, 0);
+    Reset();
+}
+
+DisplayList::~DisplayList() {
+    free(arena);
+}
+
+void DisplayList::Reset() {
+    arenaUsed = 0;
+    commandCount = 0;
+    lastRect = NULL;
+}
+
+bool DisplayList::IsEmpty() {
+    return commandCount == 0;
+}
+
+int DisplayList::GetCommandCount() {
+    return commandCount;
+}
+
+void DisplayList::SetClip(int x0, int y0, int x1, int y1) {
+    clipX0 = x0;
+    clipY0 = y0;
+    clipX1 = x1;
+    clipY1 = y1;
+}
+
+// Intersects a draw with the clip rect, the only bounds check a command ever gets
+bool DisplayList::clip(int x, int y, int w, int h, DrawCommand *bounds) {
+    if (w <= 0 || h <= 0) return false;
+    
+    // 64-bit so far-off coordinates can't wrap back into view
+    int64_t x1 = (int64_t)x + w;
+    int64_t y1 = (int64_t)y + h;
+    
+    bounds->x0 = x > clipX0 ? x : clipX0;
+    bounds->y0 = y > clipY0 ? y : clipY0;
+    bounds->x1 = x1 < clipX1 ? (int)x1 : clipX1;
+    bounds->y1 = y1 < clipY1 ? (int)y1 : clipY1;
+    
+    return bounds->x0 < bounds->x1 && bounds->y0 < bounds->y1;
+}
+
+void *DisplayList::allocate(size_t size) {
+    size = (size + 7) & ~(size_t)7;
+    if (arenaUsed + size > arenaSize || size > 0xFFFF) return NULL;
+    
+    // Zeroed so struct padding hashes the same every frame
+    void *ptr = arena + arenaUsed;
+    memset(ptr, 0, size);
+    arenaUsed += size;
+    commandCount++;
+    return ptr;
+}
+
+bool DisplayList::AddRect(int x, int y, int w, int h, Pixel pixel) {
+    DrawCommand bounds;
+    if (!clip(x, y, w, h, &bounds)) return true;
+    
+    // Merge with the previous rect when they share an edge and a color
+    if (lastRect && lastRect->pixel == pixel) {
+        DrawCommand *last = &lastRect->header;
+        
+        if (last->y0 == bounds.y0 && last->y1 == bounds.y1 && last->x1 == bounds.x0) {
+            last->x1 = bounds.x1;
+            return true;
+        }
+        if (last->x0 == bounds.x0 && last->x1 == bounds.x1 && last->y1 == bounds.y0) {
+            last->y1 = bounds.y1;
+            return true;
+        }
+    }
+    
+    RectCommand *cmd = (RectCommand *)allocate(sizeof(RectCommand));
+    if (!cmd) return false;
+    
+    cmd->header = bounds;
+    cmd->header.type = DRAW_RECT;
+    cmd->header.size = (sizeof(RectCommand) + 7) & ~7;
+    cmd->pixel = pixel;
+    
+    lastRect = cmd;
+    return true;
+}
+
+bool DisplayList::AddBlendRect(int x, int y, int w, int h, Pixel pixel) {
+    DrawCommand bounds;
+    if (!clip(x, y, w, h, &bounds)) return true;
+    
+    RectCommand *cmd = (RectCommand *)allocate(sizeof(RectCommand));
+    if (!cmd) return false;
+    
+    cmd->header = bounds;
+    cmd->header.type = DRAW_BLEND_RECT;
+    cmd->header.size = (sizeof(RectCommand) + 7) & ~7;
+    cmd->pixel = pixel;
+    
+    lastRect = NULL;
+    return true;
+}
+
+bool DisplayList::AddMask(int x, int y, int w, int h, const uint8_t *mask, int pitch, uint32_t contentID, bool flipX, bool flipY, Pixel pixel) {
+    DrawCommand bounds;
+    if (!clip(x, y, w, h, &bounds)) return true;
+    
+    MaskCommand *cmd = (MaskCommand *)allocate(sizeof(MaskCommand));
+    if (!cmd) return false;
+    
+    cmd->header = bounds;
+    cmd->header.type = DRAW_MASK;
+    cmd->header.size = (sizeof(MaskCommand) + 7) & ~7;
+    cmd->maskX = x;
+    cmd->maskY = y;
+    cmd->width = w;
+    cmd->height = h;
+    cmd->mask = mask;
+    cmd->pitch = pitch;
+    cmd->pixel = pixel;
+    cmd->contentID = contentID;
+    cmd->flipX = flipX;
+    cmd->flipY = flipY;
+    
+    lastRect = NULL;
+    return true;
+}
+
+bool DisplayList::AddGlyphRun(const BitmapFont *font, const char *text, int length, int x, int y, int scale, Pixel pixel) {
+    DrawCommand bounds;
+    if (!clip(x, y, length * font->advance * scale, font->glyphHeight * scale, &bounds)) return true;
+    
+    size_t size = offsetof(GlyphRunCommand, text) + length;
+    GlyphRunCommand *cmd = (GlyphRunCommand *)allocate(size);
+    if (!cmd) return false;
+    
+    cmd->header = bounds;
+    cmd->header.type = DRAW_GLYPH_RUN;
+    cmd->header.size = (size + 7) & ~7;
+    cmd->penX = x;
+    cmd->penY = y;
+    cmd->font = font;
+    cmd->scale = scale;
+    cmd->pixel = pixel;
+    cmd->length = length;
+    memcpy(cmd->text, text, length);
+    
+    lastRect = NULL;
+    return true;
+}
+
+bool DisplayList::AddSprite(const uint32_t *pixels, int pitch, int srcWidth, int srcHeight, uint32_t contentID, int x, int y, int w, int h, SpriteMode mode, Pixel key) {
+    DrawCommand bounds;
+    if (!clip(x, y, w, h, &bounds)) return true;
+    
+    SpriteCommand *cmd = (SpriteCommand *)allocate(sizeof(SpriteCommand));
+    if (!cmd) return false;
+    
+    cmd->header = bounds;
+    cmd->header.type = DRAW_SPRITE;
+    cmd->header.size = (sizeof(SpriteCommand) + 7) & ~7;
+    cmd->dstX = x;
+    cmd->dstY = y;
+    cmd->dstWidth = w;
+    cmd->dstHeight = h;
+    cmd->pixels = pixels;
+    cmd->pitch = pitch;
+    cmd->srcWidth = srcWidth;
+    cmd->srcHeight = srcHeight;
+    cmd->contentID = contentID;
+    cmd->mode = mode;
+    cmd->key = key;
+    
+    lastRect = NULL;
+    return true;
+}
+
+uint64_t DisplayList::HashBand(int y0, int y1) {
+    uint64_t hash = HASH_OFFSET;
+    size_t offset = 0;
+    
+    for (int i = 0; i < commandCount; i++) {
+        const DrawCommand *cmd = (const DrawCommand *)(arena + offset);
+        offset += cmd->size;
+        
+        if (cmd->y1 <= y0 || cmd->y0 >= y1) continue;
+        
+        const uint8_t *bytes = (const uint8_t *)cmd;
+        for (int b = 0; b < cmd->size; b++) {
+            hash = (hash ^ bytes[b]) * HASH_PRIME;
+        }
+    }
+    
+    return hash;
+}
+
+void DisplayList::ExecuteBand(uint32_t *target, int pitch, int bandY0, int bandY1) {
+    Occluder occluders[MAX_OCCLUDERS];
+    int numOccluders = 0;
+    size_t offset;
+    
+    // Opaque rects and copied sprites that cover a decent area hide whatever was drawn before them
+    offset = 0;
+    for (int i = 0; i < commandCount && numOccluders < MAX_OCCLUDERS; i++) {
+        const DrawCommand *cmd = (const DrawCommand *)(arena + offset);
+        offset += cmd->size;
+        
+        if (cmd->type != DRAW_RECT && cmd->type != DRAW_SPRITE) continue;
+        if (cmd->type == DRAW_SPRITE && ((const SpriteCommand *)cmd)->mode != SPRITE_COPY) continue;
+        
+        Occluder o;
+        o.order = i;
+        o.x0 = cmd->x0;
+        o.x1 = cmd->x1;
+        o.y0 = cmd->y0 < bandY0 ? bandY0 : cmd->y0;
+        o.y1 = cmd->y1 > bandY1 ? bandY1 : cmd->y1;
+        
+        if (o.y0 >= o.y1) continue;
+        if ((o.x1 - o.x0) * (o.y1 - o.y0) < OCCLUDER_MIN_AREA) continue;
+        
+        occluders[numOccluders++] = o;
+    }
+    
+    offset = 0;
+    for (int i = 0; i < commandCount; i++) {
+        const DrawCommand *cmd = (const DrawCommand *)(arena + offset);
+        offset += cmd->size;
+        
+        // Commands were clipped when recorded, only the band is left to apply
+        int x0 = cmd->x0;
+        int x1 = cmd->x1;
+        int y0 = cmd->y0 < bandY0 ? bandY0 : cmd->y0;
+        int y1 = cmd->y1 > bandY1 ? bandY1 : cmd->y1;
+        
+        if (y0 >= y1) continue;
+        
+        // Gather later occluders overlapping this draw, skip it if one hides it completely
+        Occluder covering[MAX_OCCLUDERS];
+        int numCovering = 0;
+        bool hidden = false;
+        
+        for (int o = 0; o < numOccluders; o++) {
+            const Occluder *occ = &occluders[o];
+            if (occ->order <= i) continue;
+            if (occ->x1 <= x0 || occ->x0 >= x1 || occ->y1 <= y0 || occ->y0 >= y1) continue;
+            
+            if (occ->x0 <= x0 && occ->x1 >= x1 && occ->y0 <= y0 && occ->y1 >= y1) {
+                hidden = true;
+                break;
+            }
+            covering[numCovering++] = *occ;
+        }
+        
+        if (hidden) continue;
+        
+        switch (cmd->type) {
+            case DRAW_RECT: {
+                Pixel pixel = ((const RectCommand *)cmd)->pixel;
+                
+                if (numCovering > 0 && (x1 - x0) * (y1 - y0) >= SPAN_SUBTRACT_MIN_AREA) {
+                    fillRectExcluding(target, pitch, x0, y0, x1, y1, pixel, covering, numCovering);
+                } else {
+                    fillRect(target, pitch, x0, y0, x1, y1, pixel);
+                }
+                break;
+            }
+            case DRAW_BLEND_RECT: {
+                Pixel pixel = ((const RectCommand *)cmd)->pixel;
+                
+                for (int y = y0; y < y1; y++) {
+                    BlendSpan(target + y * pitch + x0, x1 - x0, pixel);
+                }
+                break;
+            }
+            case DRAW_GLYPH_RUN:
+                drawGlyphRun((const GlyphRunCommand *)cmd, target, pitch, y0, y1);
+                break;
+            case DRAW_SPRITE:
+                drawSprite((const SpriteCommand *)cmd, target, pitch, x0, y0, x1, y1);
+                break;
+            case DRAW_MASK:
+                drawMask((const MaskCommand *)cmd, target, pitch, x0, y0, x1, y1);
+                break;
+        }
+    }
+}
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include "graphics.h"
+
+// Command types understood by the display list backend
+enum DrawCommandType {
+    DRAW_RECT,
+    DRAW_BLEND_RECT,
+    DRAW_GLYPH_RUN,
+    DRAW_SPRITE,
+    DRAW_MASK
+};
+
+// How sprite pixels are combined with the target
+enum SpriteMode {
+    SPRITE_COPY,
+    SPRITE_BLEND,       // Premultiplied source-over
+    SPRITE_COLOR_KEY    // Copy, except pixels equal to the key
+};
+
+// Common header, bounds are in target pixels and already clipped to the clip rect
+// in effect when the command was recorded, so they are never empty or out of range
+struct DrawCommand {
+    uint16_t type;
+    uint16_t size;      // Bytes including this header, commands are packed back to back
+    int x0, y0;
+    int x1, y1;
+};
+
+struct RectCommand {
+    DrawCommand header;
+    Pixel pixel;
+};
+
+struct GlyphRunCommand {
+    DrawCommand header;
+    int penX, penY;     // Unclipped origin of the run
+    const BitmapFont *font;
+    int scale;
+    Pixel pixel;
+    int length;
+    char text[1];       // length characters follow in the arena
+};
+
+struct SpriteCommand {
+    DrawCommand header;
+    int dstX, dstY;     // Unclipped destination rect the sprite is scaled to
+    int dstWidth;
+    int dstHeight;
+    const uint32_t *pixels;
+    int pitch;          // In pixels
+    int srcWidth;
+    int srcHeight;
+    uint32_t contentID; // Changes whenever the sprite's pixels change, used for frame diffing
+    int mode;           // SpriteMode
+    Pixel key;          // Transparent color for SPRITE_COLOR_KEY
+};
+
+// Constant color blended through an 8-bit coverage mask, e.g. an anti-aliased corner
+struct MaskCommand {
+    DrawCommand header;
+    int maskX, maskY;       // Unclipped placement of the whole mask
+    int width;
+    int height;
+    const uint8_t *mask;    // Must stay valid until the list is executed
+    int pitch;              // In bytes
+    Pixel pixel;
+    uint32_t contentID;     // Identifies the mask contents for frame diffing
+    uint8_t flipX;          // Mirror the mask horizontally and/or vertically
+    uint8_t flipY;
+};
+
+// Per-frame list of typed draw commands stored in a bump arena.
+// Renderer primitives record into it; ExecuteBand is the backend that rasterises
+// one horizontal band, so bands can be replayed in parallel.
+class DisplayList {
+public:
+    DisplayList(size_t arenaSize);
+    ~DisplayList();
+    
+    void Reset();
+    bool IsEmpty();
+    int GetCommandCount();
+    
+    // Commands recorded from now on are clipped to [x0, x1) x [y0, y1), which must lie within
+    // the target. The clip survives Reset.
+    void SetClip(int x0, int y0, int x1, int y1);
+    
+    // Each returns false when the arena is full and the command was not recorded
+    bool AddRect(int x, int y, int w, int h, Pixel pixel);
+    bool AddBlendRect(int x, int y, int w, int h, Pixel pixel);
+    bool AddMask(int x, int y, int w, int h, const uint8_t *mask, int pitch, uint32_t contentID, bool flipX, bool flipY, Pixel pixel);
+    bool AddGlyphRun(const BitmapFont *font, const char *text, int length, int x, int y, int scale, Pixel pixel);
+    bool AddSprite(const uint32_t *pixels, int pitch, int srcWidth, int srcHeight, uint32_t contentID, int x, int y, int w, int h, SpriteMode mode, Pixel key);
+    
+    // Hash of every command touching the band, equal hashes mean identical band output
+    uint64_t HashBand(int y0, int y1);
+    
+    void ExecuteBand(uint32_t *target, int pitch, int y0, int y1);
+    
+private:
+    void *allocate(size_t size);
+    bool clip(int x, int y, int w, int h, DrawCommand *bounds);
+    
+    uint8_t *arena;
+    size_t arenaSize;
+    size_t arenaUsed;
+    int commandCount;
+    
+    int clipX0, clipY0;
+    int clipX1, clipY1;
+    
+    // Most recent rect, candidate for merging with the next one
+    RectCommand *lastRect;
+};
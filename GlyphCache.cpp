@@ -0,0 +1,127 @@
+#include "GlyphCache.h"
+#include <stdlib.h>
+#include <string.h>
+
+GlyphCache::GlyphCache() {
+    memset(entries, 0, sizeof(entries));
+    
+    for (int i = 0; i < GLYPH_CACHE_BUCKETS; i++) {
+        buckets[i] = -1;
+    }
+    
+    head = -1;
+    tail = -1;
+    used = 0;
+    nextContentID = 1;
+}
+
+GlyphCache::~GlyphCache() {
+    for (int i = 0; i < used; i++) {
+        free(entries[i].coverage);
+    }
+}
+
+uint32_t GlyphCache::hashKey(const void *face, int size, uint32_t codepoint) {
+    uint32_t h = (uint32_t)(uintptr_t)face * 2654435761u;
+    h ^= (uint32_t)size * 40503u;
+    h ^= codepoint * 2246822519u;
+    return (h ^ (h >> 15)) & (GLYPH_CACHE_BUCKETS - 1);
+}
+
+void GlyphCache::unlinkLRU(int index) {
+    CachedGlyph *g = &entries[index];
+    
+    if (g->prev >= 0) entries[g->prev].next = g->next;
+    else head = g->next;
+    
+    if (g->next >= 0) entries[g->next].prev = g->prev;
+    else tail = g->prev;
+}
+
+void GlyphCache::pushFront(int index) {
+    CachedGlyph *g = &entries[index];
+    
+    g->prev = -1;
+    g->next = head;
+    
+    if (head >= 0) entries[head].prev = index;
+    head = index;
+    
+    if (tail < 0) tail = index;
+}
+
+void GlyphCache::unlinkHash(int index) {
+    CachedGlyph *g = &entries[index];
+    int *link = &buckets[hashKey(g->face, g->size, g->codepoint)];
+    
+    while (*link >= 0) {
+        if (*link == index) {
+            *link = g->hashNext;
+            return;
+        }
+        link = &entries[*link].hashNext;
+    }
+}
+
+CachedGlyph *GlyphCache::Find(const void *face, int size, uint32_t codepoint) {
+    for (int i = buckets[hashKey(face, size, codepoint)]; i >= 0; i = entries[i].hashNext) {
+        CachedGlyph *g = &entries[i];
+        
+        if (g->face == face && g->size == size && g->codepoint == codepoint) {
+            if (head != i) {
+                unlinkLRU(i);
+                pushFront(i);
+            }
+            return g;
+        }
+    }
+    
+    return NULL;
+}
+
+CachedGlyph *GlyphCache::Victim() {
+    if (used < GLYPH_CACHE_SIZE) return NULL;
+    return &entries[tail];
+}
+
+CachedGlyph *GlyphCache::Insert(const void *face, int size, uint32_t codepoint) {
+    int index;
+    
+    if (used < GLYPH_CACHE_SIZE) {
+        index = used++;
+    } else {
+        index = tail;
+        unlinkLRU(index);
+        unlinkHash(index);
+    }
+    
+    CachedGlyph *g = &entries[index];
+    g->face = face;
+    g->size = size;
+    g->codepoint = codepoint;
+    g->width = 0;
+    g->rows = 0;
+    g->left = 0;
+    g->top = 0;
+    g->advance = 0;
+    g->contentID = nextContentID++;
+    g->usedEpoch = 0;
+    
+    uint32_t bucket = hashKey(face, size, codepoint);
+    g->hashNext = buckets[bucket];
+    buckets[bucket] = index;
+    
+    pushFront(index);
+    return g;
+}
+
+bool GlyphCache::Reserve(CachedGlyph *glyph, size_t bytes) {
+    if (bytes <= glyph->capacity) return true;
+    
+    uint8_t *coverage = (uint8_t *)realloc(glyph->coverage, bytes);
+    if (!coverage) return false;
+    
+    glyph->coverage = coverage;
+    glyph->capacity = bytes;
+    return true;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Glyphs kept rendered at once, and hash buckets over them (power of two)
+#define GLYPH_CACHE_SIZE 512
+#define GLYPH_CACHE_BUCKETS 1024
+
+// One rendered glyph: 8-bit coverage plus the metrics needed to place it
+struct CachedGlyph {
+    const void *face;       // Key: font face, pixel size and codepoint
+    int size;
+    uint32_t codepoint;
+    
+    int width;              // Coverage is width x rows with a pitch of width
+    int rows;
+    int left;               // Offset from the pen position to the bitmap's top-left
+    int top;
+    int advance;            // Pen advance in pixels
+    uint8_t *coverage;
+    size_t capacity;
+    
+    uint32_t contentID;     // Unique per fill, so reused slots never hash like the old glyph
+    uint32_t usedEpoch;     // Last display list flush that referenced the coverage
+    
+    int prev;               // LRU list, most recently used first
+    int next;
+    int hashNext;
+};
+
+// Fixed-size LRU cache of rendered glyph bitmaps, independent of the font library
+class GlyphCache {
+public:
+    GlyphCache();
+    ~GlyphCache();
+    
+    // Returns the cached glyph and marks it most recently used, or NULL on a miss
+    CachedGlyph *Find(const void *face, int size, uint32_t codepoint);
+    
+    // The entry the next Insert will recycle, NULL while unused slots remain
+    CachedGlyph *Victim();
+    
+    // Claims an entry for the key, evicting the least recently used glyph if needed
+    CachedGlyph *Insert(const void *face, int size, uint32_t codepoint);
+    
+    // Grows the entry's coverage buffer to hold at least bytes
+    bool Reserve(CachedGlyph *glyph, size_t bytes);
+    
+private:
+    static uint32_t hashKey(const void *face, int size, uint32_t codepoint);
+    void unlinkLRU(int index);
+    void pushFront(int index);
+    void unlinkHash(int index);
+    
+    CachedGlyph entries[GLYPH_CACHE_SIZE];
+    int buckets[GLYPH_CACHE_BUCKETS];
+    int head;
+    int tail;
+    int used;
+    uint32_t nextContentID;
+};
@@ -0,0 +1,211 @@
+#include "ImageWriter.h"
+#include <stdio.h>
+#include <string.h>
+
+// Largest payload of one stored deflate block
+#define DEFLATE_STORED_MAX 65535
+
+static uint32_t crcTable[256];
+static bool crcTableReady = false;
+
+static void initCrcTable() {
+    for (uint32_t n = 0; n < 256; n++) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++) {
+            c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        }
+        crcTable[n] = c;
+    }
+    crcTableReady = true;
+}
+
+static uint32_t updateCrc(uint32_t crc, const uint8_t *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        crc = crcTable[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+// Converts one row to packed RGB
+static void packRow(uint8_t *out, const uint32_t *row, int width, PixelFormat format) {
+    bool bgr = (format == PIXEL_FORMAT_A8B8G8R8_SRGB);
+    
+    for (int x = 0; x < width; x++) {
+        uint32_t p = row[x];
+        uint8_t hi = (p >> 16) & 0xFF;
+        uint8_t lo = p & 0xFF;
+        
+        out[x * 3 + 0] = bgr ? lo : hi;
+        out[x * 3 + 1] = (p >> 8) & 0xFF;
+        out[x * 3 + 2] = bgr ? hi : lo;
+    }
+}
+
+bool WritePPM(const char *path, const uint32_t *pixels, int width, int height, int pitch, PixelFormat format) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+    
+    uint8_t *row = new uint8_t[width * 3];
+    bool ok = fprintf(file, "P6\n%d %d\n255\n", width, height) > 0;
+    
+    for (int y = 0; y < height && ok; y++) {
+        packRow(row, pixels + y * pitch, width, format);
+        ok = fwrite(row, 3, width, file) == (size_t)width;
+    }
+    
+    delete[] row;
+    return (fclose(file) == 0) && ok;
+}
+
+// Streams one IDAT chunk made of stored deflate blocks, tracking the chunk CRC and zlib Adler-32
+struct PngWriter {
+    FILE *file;
+    uint32_t crc;
+    uint32_t adlerA;
+    uint32_t adlerB;
+    uint8_t block[DEFLATE_STORED_MAX];
+    size_t blockUsed;
+    size_t remaining;       // Raw bytes not yet placed in a block
+    bool ok;
+    
+    void writeRaw(const uint8_t *data, size_t length) {
+        crc = updateCrc(crc, data, length);
+        if (fwrite(data, 1, length, file) != length) ok = false;
+    }
+    
+    void writeBE32(uint32_t v) {
+        uint8_t b[4] = { (uint8_t)(v >> 24), (uint8_t)(v >> 16), (uint8_t)(v >> 8), (uint8_t)v };
+        writeRaw(b, 4);
+    }
+    
+    void flushBlock() {
+        uint8_t header[5];
+        bool final = (remaining == 0);
+        
+        header[0] = final ? 1 : 0;
+        header[1] = blockUsed & 0xFF;
+        header[2] = (blockUsed >> 8) & 0xFF;
+        header[3] = ~blockUsed & 0xFF;
+        header[4] = (~blockUsed >> 8) & 0xFF;
+        
+        writeRaw(header, 5);
+        writeRaw(block, blockUsed);
+        blockUsed = 0;
+    }
+    
+    void put(const uint8_t *data, size_t length) {
+        // Adler-32 sums stay below 2^32 for 5552 bytes at a time
+        for (size_t i = 0; i < length; ) {
+            size_t n = length - i;
+            if (n > 5552) n = 5552;
+            
+            for (size_t k = 0; k < n; k++) {
+                adlerA += data[i + k];
+                adlerB += adlerA;
+            }
+            adlerA %= 65521;
+            adlerB %= 65521;
+            i += n;
+        }
+        
+        while (length > 0) {
+            size_t n = DEFLATE_STORED_MAX - blockUsed;
+            if (n > length) n = length;
+            
+            memcpy(block + blockUsed, data, n);
+            blockUsed += n;
+            remaining -= n;
+            data += n;
+            length -= n;
+            
+            if (blockUsed == DEFLATE_STORED_MAX || remaining == 0) flushBlock();
+        }
+    }
+};
+
+static void writeChunk(FILE *file, const char *type, const uint8_t *data, uint32_t length, bool *ok) {
+    uint8_t header[8] = {
+        (uint8_t)(length >> 24), (uint8_t)(length >> 16), (uint8_t)(length >> 8), (uint8_t)length,
+        (uint8_t)type[0], (uint8_t)type[1], (uint8_t)type[2], (uint8_t)type[3]
+    };
+    
+    uint32_t crc = updateCrc(0xFFFFFFFFu, header + 4, 4);
+    crc = updateCrc(crc, data, length) ^ 0xFFFFFFFFu;
+    uint8_t footer[4] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+    
+    if (fwrite(header, 1, 8, file) != 8) *ok = false;
+    if (length > 0 && fwrite(data, 1, length, file) != length) *ok = false;
+    if (fwrite(footer, 1, 4, file) != 4) *ok = false;
+}
+
+bool WritePNG(const char *path, const uint32_t *pixels, int width, int height, int pitch, PixelFormat format) {
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    
+    if (!crcTableReady) initCrcTable();
+    
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+    
+    bool ok = fwrite(signature, 1, 8, file) == 8;
+    
+    // 8-bit RGB, no interlacing
+    uint8_t ihdr[13] = {
+        (uint8_t)(width >> 24), (uint8_t)(width >> 16), (uint8_t)(width >> 8), (uint8_t)width,
+        (uint8_t)(height >> 24), (uint8_t)(height >> 16), (uint8_t)(height >> 8), (uint8_t)height,
+        8, 2, 0, 0, 0
+    };
+    writeChunk(file, "IHDR", ihdr, sizeof(ihdr), &ok);
+    
+    // Every row is a filter byte (none) followed by its RGB bytes
+    size_t rawSize = (size_t)(width * 3 + 1) * height;
+    size_t blocks = (rawSize + DEFLATE_STORED_MAX - 1) / DEFLATE_STORED_MAX;
+    size_t zlibSize = 2 + rawSize + blocks * 5 + 4;
+    
+    PngWriter *png = new PngWriter();
+    png->file = file;
+    png->crc = 0xFFFFFFFFu;
+    png->adlerA = 1;
+    png->adlerB = 0;
+    png->blockUsed = 0;
+    png->remaining = rawSize;
+    png->ok = ok;
+    
+    uint8_t idatHeader[8] = {
+        (uint8_t)(zlibSize >> 24), (uint8_t)(zlibSize >> 16), (uint8_t)(zlibSize >> 8), (uint8_t)zlibSize,
+        'I', 'D', 'A', 'T'
+    };
+    if (fwrite(idatHeader, 1, 4, file) != 4) png->ok = false;
+    png->writeRaw(idatHeader + 4, 4);
+    
+    // zlib header: deflate with a 32K window, no preset dictionary
+    static const uint8_t zlibHeader[2] = { 0x78, 0x01 };
+    png->writeRaw(zlibHeader, 2);
+    
+    uint8_t *row = new uint8_t[width * 3 + 1];
+    row[0] = 0;
+    
+    for (int y = 0; y < height; y++) {
+        packRow(row + 1, pixels + y * pitch, width, format);
+        png->put(row, width * 3 + 1);
+    }
+    
+    png->writeBE32((png->adlerB << 16) | png->adlerA);
+    
+    uint32_t crc = png->crc ^ 0xFFFFFFFFu;
+    uint8_t footer[4] = { (uint8_t)(crc >> 24), (uint8_t)(crc >> 16), (uint8_t)(crc >> 8), (uint8_t)crc };
+    if (fwrite(footer, 1, 4, file) != 4) png->ok = false;
+    
+    ok = png->ok;
+    writeChunk(file, "IEND", NULL, 0, &ok);
+    
+    delete[] row;
+    delete png;
+    return (fclose(file) == 0) && ok;
+}
+
+bool WriteImage(const char *path, const uint32_t *pixels, int width, int height, int pitch, PixelFormat format, ImageFileFormat fileFormat) {
+    if (fileFormat == IMAGE_FILE_PNG) {
+        return WritePNG(path, pixels, width, height, pitch, format);
+    }
+    return WritePPM(path, pixels, width, height, pitch, format);
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+#include "graphics.h"
+
+// Writes native frame buffer pixels as 8-bit RGB images, dropping alpha. pitch is in pixels.
+// PNGs are written with stored (uncompressed) deflate blocks, which keeps the encoder tiny
+// and its cost a plain copy plus CRC and Adler checksums.
+bool WritePPM(const char *path, const uint32_t *pixels, int width, int height, int pitch, PixelFormat format);
+bool WritePNG(const char *path, const uint32_t *pixels, int width, int height, int pitch, PixelFormat format);
+
+// Dispatches on fileFormat
+bool WriteImage(const char *path, const uint32_t *pixels, int width, int height, int pitch, PixelFormat format, ImageFileFormat fileFormat);
@@ -7,26 +7,26 @@ void Input::Init(Controller* ctrl) {
     controller = ctrl;
 }
 
-Direction Input::GetDirectionInput(int& analogCooldown) {
+Direction Input::GetDirectionInput(uint64_t& analogReadyTime, uint64_t now) {
     if (!controller) return DIR_NONE;
     
-    // Check D-Pad first (priority)
-    if (controller->DpadUpPressed()) return DIR_UP;
-    if (controller->DpadDownPressed()) return DIR_DOWN;
-    if (controller->DpadLeftPressed()) return DIR_LEFT;
-    if (controller->DpadRightPressed()) return DIR_RIGHT;
+    // Check D-Pad first (priority), each press is one move however long it is held
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_UP)) return DIR_UP;
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_DOWN)) return DIR_DOWN;
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_LEFT)) return DIR_LEFT;
+    if (controller->WasPressed(ORBIS_PAD_BUTTON_RIGHT)) return DIR_RIGHT;
     
     // Check analog stick (with cooldown)
-    if (analogCooldown == 0) {
+    if (now >= analogReadyTime) {
         float stickX = controller->GetLeftStickX();
         float stickY = controller->GetLeftStickY();
         
         if (fabsf(stickY) > ANALOG_DEADZONE && fabsf(stickY) > fabsf(stickX)) {
-            analogCooldown = ANALOG_INPUT_DELAY;
+            analogReadyTime = now + ANALOG_REPEAT_USEC;
             if (stickY < 0) return DIR_UP;
             else return DIR_DOWN;
         } else if (fabsf(stickX) > ANALOG_DEADZONE) {
-            analogCooldown = ANALOG_INPUT_DELAY;
+            analogReadyTime = now + ANALOG_REPEAT_USEC;
             if (stickX < 0) return DIR_LEFT;
             else return DIR_RIGHT;
         }
@@ -39,17 +39,17 @@ Direction Input::GetDirectionInput(int& analogCooldown) {
 }
 
 bool Input::IsConfirmPressed() {
-    return controller ? controller->XPressed() : false;
+    return controller ? controller->WasPressed(ORBIS_PAD_BUTTON_CROSS) : false;
 }
 
 bool Input::IsCancelPressed() {
-    return controller ? controller->CirclePressed() : false;
+    return controller ? controller->WasPressed(ORBIS_PAD_BUTTON_CIRCLE) : false;
 }
 
 bool Input::IsQuitPressed() {
-    return controller ? controller->SquarePressed() : false;
+    return controller ? controller->WasPressed(ORBIS_PAD_BUTTON_SQUARE) : false;
 }
 
 bool Input::IsRestartPressed() {
-    return controller ? controller->StartPressed() : false;
+    return controller ? controller->WasPressed(ORBIS_PAD_BUTTON_OPTIONS) : false;
 }
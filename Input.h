@@ -1,9 +1,10 @@
 #pragma once
 
+#include <stdint.h>
 #include "controller.h"
 
 // Input handling constants
-#define ANALOG_INPUT_DELAY 15 // Frames to wait between analog inputs (~1 second at 15 FPS)
+#define ANALOG_REPEAT_USEC 250000   // Time between repeated moves while the stick is held
 #define ANALOG_DEADZONE 0.5f
 
 // Direction enum
@@ -19,7 +20,9 @@ enum Direction {
 class Input {
 public:
     static void Init(Controller* ctrl);
-    static Direction GetDirectionInput(int& analogCooldown);
+    // analogReadyTime is when the stick may next produce a move, updated when it does.
+    // Like the button queries, reads the snapshot from the last Controller::Update.
+    static Direction GetDirectionInput(uint64_t& analogReadyTime, uint64_t now);
     static bool IsConfirmPressed();
     static bool IsCancelPressed();
     static bool IsQuitPressed();
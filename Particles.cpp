@@ -0,0 +1,121 @@
+#include "Particles.h"
+#include "Blend.h"
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+ParticleSystem::ParticleSystem() {
+    seed = 0x9E3779B9u;
+    Clear();
+}
+
+void ParticleSystem::Clear() {
+    // Whole groups are updated, so slots past count must hold harmless values
+    memset(posX, 0, sizeof(posX));
+    memset(posY, 0, sizeof(posY));
+    memset(velX, 0, sizeof(velX));
+    memset(velY, 0, sizeof(velY));
+    memset(life, 0, sizeof(life));
+    memset(decay, 0, sizeof(decay));
+    count = 0;
+}
+
+int ParticleSystem::GetCount() {
+    return count;
+}
+
+// xorshift32, mapped to [0, 1)
+float ParticleSystem::randomUnit() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return (float)(seed >> 8) * (1.0f / 16777216.0f);
+}
+
+void ParticleSystem::Emit(float x, float y, int n, float speed, float lifeSec, Pixel c) {
+    if (n > PARTICLE_CAPACITY - count) n = PARTICLE_CAPACITY - count;
+    
+    for (int k = 0; k < n; k++) {
+        int i = count++;
+        float angle = randomUnit() * 2.0f * (float)M_PI;
+        float v = speed * (0.3f + 0.7f * randomUnit());
+        
+        posX[i] = x;
+        posY[i] = y;
+        velX[i] = cosf(angle) * v;
+        velY[i] = sinf(angle) * v - speed * 0.5f;   // Bias upwards against gravity
+        life[i] = 1.0f;
+        decay[i] = 1.0f / (lifeSec * (0.6f + 0.4f * randomUnit()));
+        color[i] = c;
+    }
+}
+
+void ParticleSystem::Update(float dt) {
+    float drag = powf(PARTICLE_DRAG, dt);
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128 vdt = _mm_set1_ps(dt);
+    const __m128 vdrag = _mm_set1_ps(drag);
+    const __m128 vgravity = _mm_set1_ps(PARTICLE_GRAVITY * dt);
+    
+    // Trailing slots of the last group are dead or zeroed, updating them is harmless
+    for (; i < count; i += 4) {
+        __m128 vx = _mm_mul_ps(_mm_load_ps(velX + i), vdrag);
+        __m128 vy = _mm_add_ps(_mm_mul_ps(_mm_load_ps(velY + i), vdrag), vgravity);
+        
+        _mm_store_ps(velX + i, vx);
+        _mm_store_ps(velY + i, vy);
+        _mm_store_ps(posX + i, _mm_add_ps(_mm_load_ps(posX + i), _mm_mul_ps(vx, vdt)));
+        _mm_store_ps(posY + i, _mm_add_ps(_mm_load_ps(posY + i), _mm_mul_ps(vy, vdt)));
+        _mm_store_ps(life + i, _mm_sub_ps(_mm_load_ps(life + i), _mm_mul_ps(_mm_load_ps(decay + i), vdt)));
+    }
+#else
+    for (; i < count; i++) {
+        velX[i] *= drag;
+        velY[i] = velY[i] * drag + PARTICLE_GRAVITY * dt;
+        posX[i] += velX[i] * dt;
+        posY[i] += velY[i] * dt;
+        life[i] -= decay[i] * dt;
+    }
+#endif
+
+    // Move the last live particle into each dead slot, keeping the pool packed
+    i = 0;
+    while (i < count) {
+#if defined(__SSE2__)
+        if ((i & 3) == 0 && i + 4 <= count && _mm_movemask_ps(_mm_cmple_ps(_mm_load_ps(life + i), _mm_setzero_ps())) == 0) {
+            i += 4;
+            continue;
+        }
+#endif
+        if (life[i] > 0.0f) {
+            i++;
+            continue;
+        }
+        
+        int last = --count;
+        posX[i] = posX[last];
+        posY[i] = posY[last];
+        velX[i] = velX[last];
+        velY[i] = velY[last];
+        life[i] = life[last];
+        decay[i] = decay[last];
+        color[i] = color[last];
+        life[last] = 0.0f;
+    }
+}
+
+void ParticleSystem::Draw(Scene2D* scene, int size) {
+    int half = size / 2;
+    
+    for (int i = 0; i < count; i++) {
+        uint32_t alpha = (uint32_t)(life[i] * 255.0f);
+        if (alpha == 0) continue;
+        
+        scene->DrawBlendedRectangle((int)posX[i] - half, (int)posY[i] - half, size, size, ScalePixel(color[i], alpha));
+    }
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+#include "graphics.h"
+
+// Fixed pool size, a multiple of 4 so updates run in whole SIMD groups
+#define PARTICLE_CAPACITY 4096
+
+// Downward acceleration and per-second velocity retention
+#define PARTICLE_GRAVITY 1800.0f
+#define PARTICLE_DRAG 0.15f
+
+// Short-lived blended quads, e.g. the burst over a merged tile. Fields are kept in separate
+// aligned arrays (structure of arrays) so Update moves four particles per SSE instruction,
+// and live particles are packed at the front so nothing is scanned past count.
+class ParticleSystem {
+public:
+    ParticleSystem();
+    
+    // Spray count particles from (x, y) in pixels, at up to speed pixels per second. Particles
+    // that don't fit in the pool are dropped.
+    void Emit(float x, float y, int count, float speed, float lifeSec, Pixel color);
+    
+    void Update(float dt);
+    
+    // Draw every live particle as a size x size blended quad, fading out with its life
+    void Draw(Scene2D* scene, int size);
+    
+    void Clear();
+    int GetCount();
+
+private:
+    float randomUnit();
+    
+    alignas(16) float posX[PARTICLE_CAPACITY];
+    alignas(16) float posY[PARTICLE_CAPACITY];
+    alignas(16) float velX[PARTICLE_CAPACITY];
+    alignas(16) float velY[PARTICLE_CAPACITY];
+    alignas(16) float life[PARTICLE_CAPACITY];      // 1 when emitted, dead at 0
+    alignas(16) float decay[PARTICLE_CAPACITY];     // Life lost per second
+    Pixel color[PARTICLE_CAPACITY];
+    
+    int count;
+    uint32_t seed;
+};
@@ -0,0 +1,51 @@
+#include "Profiler.h"
+#include <string.h>
+
+Profiler::Profiler() {
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        phaseTotal[i] = 0;
+        phaseCount[i] = 0;
+    }
+    
+    frames = 0;
+    worstFrame = 0;
+    lastPresent = 0;
+    windowStart = 0;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void Profiler::AddSample(ProfilePhase phase, uint64_t usec) {
+    phaseTotal[phase].fetch_add(usec, std::memory_order_relaxed);
+    phaseCount[phase].fetch_add(1, std::memory_order_relaxed);
+}
+
+void Profiler::FramePresented(uint64_t now) {
+    if (lastPresent != 0) {
+        uint32_t gap = (uint32_t)(now - lastPresent);
+        uint32_t worst = worstFrame.load(std::memory_order_relaxed);
+        
+        while (gap > worst && !worstFrame.compare_exchange_weak(worst, gap, std::memory_order_relaxed)) {
+        }
+    }
+    
+    lastPresent = now;
+    frames.fetch_add(1, std::memory_order_relaxed);
+}
+
+const ProfilerStats& Profiler::GetStats(uint64_t now) {
+    if (windowStart == 0) windowStart = now;
+    
+    uint64_t elapsed = now - windowStart;
+    if (elapsed < PROFILER_WINDOW_USEC) return stats;
+    
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        uint64_t total = phaseTotal[i].exchange(0, std::memory_order_relaxed);
+        uint32_t count = phaseCount[i].exchange(0, std::memory_order_relaxed);
+        stats.phaseUsec[i] = count ? (uint32_t)(total / count) : 0;
+    }
+    
+    stats.fps = (uint32_t)((frames.exchange(0, std::memory_order_relaxed) * 1000000ull + elapsed / 2) / elapsed);
+    stats.worstFrameUsec = worstFrame.exchange(0, std::memory_order_relaxed);
+    windowStart = now;
+    return stats;
+}
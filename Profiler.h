@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include "Timer.h"
+
+// Length of the rolling window shown by the overlay
+#define PROFILER_WINDOW_USEC 1000000
+
+// Timed phases of the pipelined loop, each may run on a different thread
+enum ProfilePhase {
+    PHASE_UPDATE,
+    PHASE_RENDER,
+    PHASE_RESOLVE,
+    PHASE_SUBMIT_FLIP,
+    PHASE_FRAME_WAIT,
+    PHASE_RECORD,           // Render thread time spent capturing frames while recording
+    PHASE_COUNT
+};
+
+// Averages over the last complete window
+struct ProfilerStats {
+    uint32_t phaseUsec[PHASE_COUNT];
+    uint32_t fps;
+    uint32_t worstFrameUsec;    // Longest gap between two presented frames
+};
+
+// Collects per-phase CPU time from any thread with relaxed atomics, so sampling costs
+// a couple of uncontended adds. The render thread rolls the window over once a second.
+class Profiler {
+public:
+    Profiler();
+    
+    void AddSample(ProfilePhase phase, uint64_t usec);
+    void FramePresented(uint64_t now);
+    
+    // Returns the last complete window, starting a new one when the current one has expired
+    const ProfilerStats& GetStats(uint64_t now);
+    
+private:
+    std::atomic<uint64_t> phaseTotal[PHASE_COUNT];
+    std::atomic<uint32_t> phaseCount[PHASE_COUNT];
+    std::atomic<uint32_t> frames;
+    std::atomic<uint32_t> worstFrame;
+    uint64_t lastPresent;       // Only touched by the present thread
+    
+    uint64_t windowStart;
+    ProfilerStats stats;
+};
+
+// Times the enclosing scope into one phase
+class ProfileScope {
+public:
+    ProfileScope(Profiler* profiler, ProfilePhase phase) : profiler(profiler), phase(phase), start(GetTimeUsec()) {}
+    ~ProfileScope() { profiler->AddSample(phase, GetTimeUsec() - start); }
+    
+private:
+    Profiler* profiler;
+    ProfilePhase phase;
+    uint64_t start;
+};
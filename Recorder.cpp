@@ -0,0 +1,302 @@
+#include "Recorder.h"
+#include "Timer.h"
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef SCENE2D_HEADLESS
+#include <orbis/libkernel.h>
+#endif
+
+// Tried in order until one is writable, like screenshots
+static const char* const recordingDirs[] = {
+    "/mnt/usb0/",
+    "/data/",
+    "/user/home/"
+};
+
+Recorder::Recorder() {
+    for (int i = 0; i < RECORD_RING_SIZE; i++) {
+        ring[i].pixels = nullptr;
+    }
+    
+    writeIndex = 0;
+    readIndex = 0;
+    width = 0;
+    height = 0;
+    format = PIXEL_FORMAT_A8R8G8B8_SRGB;
+    
+    activeSession = 0;
+    nextSession = 0;
+    frameCounter = 0;
+    
+    file = nullptr;
+    fileSession = 0;
+    previous = nullptr;
+    output = nullptr;
+    
+    captured = 0;
+    dropped = 0;
+    encoded = 0;
+    bytesWritten = 0;
+    
+    quitting = false;
+    started = false;
+}
+
+Recorder::~Recorder() {
+    Shutdown();
+}
+
+bool Recorder::Init(Scene2D* scene) {
+    Shutdown();
+    
+    width = scene->GetWidth() / RECORD_SCALE;
+    height = scene->GetHeight() / RECORD_SCALE;
+    format = scene->GetPixelFormat();
+    
+    // Worst case alternates single unchanged and changed pixels, a run header for every two,
+    // so twice the frame size is ample
+    size_t frameSize = (size_t)width * height * sizeof(uint32_t);
+    bool ok = posix_memalign((void**)&previous, 64, frameSize) == 0;
+    output = (uint8_t*)malloc(frameSize * 2);
+    ok = ok && output;
+    
+    for (int i = 0; i < RECORD_RING_SIZE && ok; i++) {
+        ok = posix_memalign((void**)&ring[i].pixels, 64, frameSize) == 0;
+        if (ok) memset(ring[i].pixels, 0, frameSize);
+    }
+    
+    if (!ok) {
+        printf("[ERROR] Failed to allocate recording buffers\n");
+        Shutdown();
+        return false;
+    }
+    
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+#ifndef SCENE2D_HEADLESS
+    // Lowest priority, encoding only uses time the game threads leave idle
+    sched_param param;
+    param.sched_priority = ORBIS_KERNEL_PRIO_FIFO_LOWEST;
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedparam(&attr, &param);
+#endif
+
+    quitting = false;
+    int rc = pthread_create(&thread, &attr, encoderThread, this);
+    pthread_attr_destroy(&attr);
+    
+    if (rc != 0) {
+        printf("[ERROR] Failed to create recording thread\n");
+        Shutdown();
+        return false;
+    }
+    
+    started = true;
+    return true;
+}
+
+void Recorder::Shutdown() {
+    if (started) {
+        // The encoder drains the ring and closes the file before it exits
+        Stop();
+        quitting = true;
+        pthread_join(thread, nullptr);
+        started = false;
+    }
+    
+    for (int i = 0; i < RECORD_RING_SIZE; i++) {
+        free(ring[i].pixels);
+        ring[i].pixels = nullptr;
+    }
+    
+    free(previous);
+    free(output);
+    previous = nullptr;
+    output = nullptr;
+    writeIndex = 0;
+    readIndex = 0;
+}
+
+void Recorder::Start() {
+    if (!started || activeSession != 0) return;
+    
+    // Session 0 means stopped, so skip it when the counter wraps
+    if (++nextSession == 0) nextSession = 1;
+    
+    // The encoder may still be draining the last session, it resets its own counters when
+    // it opens this session's file
+    captured = 0;
+    dropped = 0;
+    frameCounter = 0;
+    activeSession = nextSession;
+}
+
+void Recorder::Stop() {
+    if (activeSession == 0) return;
+    
+    // Nothing more is captured for the session, so its capture counts are final here
+    activeSession = 0;
+    printf("[INFO] Recording stopped, %u frames captured, %u dropped\n", (unsigned int)captured, (unsigned int)dropped);
+}
+
+bool Recorder::IsRecording() {
+    return activeSession != 0;
+}
+
+RecorderStats Recorder::GetStats() {
+    RecorderStats stats;
+    stats.captured = captured;
+    stats.dropped = dropped;
+    stats.encoded = encoded;
+    stats.bytesWritten = bytesWritten;
+    return stats;
+}
+
+bool Recorder::CaptureFrame(Scene2D* scene, int frameID) {
+    unsigned int session = activeSession.load(std::memory_order_relaxed);
+    if (session == 0) return false;
+    
+    if (frameCounter++ % RECORD_FRAME_INTERVAL != 0) return false;
+    
+    unsigned int write = writeIndex.load(std::memory_order_relaxed);
+    unsigned int read = readIndex.load(std::memory_order_acquire);
+    
+    // Full: the encoder is behind, drop this frame rather than wait for it
+    if (write - read == RECORD_RING_SIZE) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    
+    Slot* slot = &ring[write % RECORD_RING_SIZE];
+    scene->CopyFrameScaled(slot->pixels, width, RECORD_SCALE);
+    slot->frameID = (uint32_t)frameID;
+    slot->time = GetTimeUsec();
+    slot->session = session;
+    
+    writeIndex.store(write + 1, std::memory_order_release);
+    captured.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+void* Recorder::encoderThread(void* arg) {
+    Recorder* rec = (Recorder*)arg;
+    
+    for (;;) {
+        unsigned int read = rec->readIndex.load(std::memory_order_relaxed);
+        unsigned int write = rec->writeIndex.load(std::memory_order_acquire);
+        
+        if (read != write) {
+            const Slot* slot = &rec->ring[read % RECORD_RING_SIZE];
+            
+            if (slot->session != rec->fileSession) {
+                rec->closeFile();
+                rec->openFile(slot->session);
+            }
+            if (rec->file) rec->encodeFrame(slot);
+            
+            rec->readIndex.store(read + 1, std::memory_order_release);
+            continue;
+        }
+        
+        // Drained, so a stopped session has nothing more to write
+        if (rec->file && rec->activeSession != rec->fileSession) {
+            rec->closeFile();
+        }
+        
+        if (rec->quitting) break;
+        SleepUsec(RECORD_POLL_USEC);
+    }
+    
+    rec->closeFile();
+    return nullptr;
+}
+
+bool Recorder::openFile(unsigned int session) {
+    fileSession = session;
+    
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    
+    // The session number keeps recordings started within the same second apart
+    char name[64];
+    snprintf(name, sizeof(name), "2048_%04d%02d%02d_%02d%02d%02d_%u.s2dv",
+             local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+             local.tm_hour, local.tm_min, local.tm_sec, session);
+    
+    char path[128];
+    for (size_t i = 0; i < sizeof(recordingDirs) / sizeof(recordingDirs[0]) && !file; i++) {
+        snprintf(path, sizeof(path), "%s%s", recordingDirs[i], name);
+        file = fopen(path, "wb");
+    }
+    
+    if (!file) {
+        printf("[ERROR] Failed to create recording %s in any location\n", name);
+        return false;
+    }
+    
+    encoded = 0;
+    bytesWritten = 0;
+    
+    uint32_t header[5] = { RECORD_FILE_MAGIC, RECORD_FILE_VERSION, (uint32_t)width, (uint32_t)height, (uint32_t)format };
+    fwrite(header, sizeof(header), 1, file);
+    bytesWritten += sizeof(header);
+    
+    // The first frame is a delta against black
+    memset(previous, 0, (size_t)width * height * sizeof(uint32_t));
+    
+    printf("[INFO] Recording to %s\n", path);
+    return true;
+}
+
+void Recorder::closeFile() {
+    if (!file) return;
+    
+    fclose(file);
+    file = nullptr;
+    printf("[INFO] Recording closed, %u frames encoded, %llu bytes\n", (unsigned int)encoded, (unsigned long long)bytesWritten);
+}
+
+void Recorder::encodeFrame(const Slot* slot) {
+    const uint32_t* current = slot->pixels;
+    int count = width * height;
+    uint8_t* out = output;
+    int i = 0;
+    
+    while (i < count) {
+        int start = i;
+        while (i < count && i - start < 0xFFFF && current[i] == previous[i]) i++;
+        uint16_t unchanged = (uint16_t)(i - start);
+        
+        start = i;
+        while (i < count && i - start < 0xFFFF && current[i] != previous[i]) i++;
+        uint16_t changed = (uint16_t)(i - start);
+        
+        memcpy(out, &unchanged, 2);
+        memcpy(out + 2, &changed, 2);
+        memcpy(out + 4, current + start, changed * sizeof(uint32_t));
+        out += 4 + changed * sizeof(uint32_t);
+    }
+    
+    uint32_t payload = (uint32_t)(out - output);
+    uint8_t frameHeader[16];
+    memcpy(frameHeader, &slot->frameID, 4);
+    memcpy(frameHeader + 4, &slot->time, 8);
+    memcpy(frameHeader + 12, &payload, 4);
+    
+    bool ok = fwrite(frameHeader, sizeof(frameHeader), 1, file) == 1;
+    ok = ok && fwrite(output, payload, 1, file) == 1;
+    
+    if (!ok) {
+        printf("[ERROR] Recording write failed, closing the file\n");
+        closeFile();
+        return;
+    }
+    
+    memcpy(previous, current, (size_t)count * sizeof(uint32_t));
+    bytesWritten += sizeof(frameHeader) + payload;
+    encoded++;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include "graphics.h"
+
+// Recorded frames are point sampled down by this factor, and every RECORD_FRAME_INTERVAL-th
+// rendered frame is kept
+#define RECORD_SCALE 3
+#define RECORD_FRAME_INTERVAL 2
+
+// Frames in flight between the render thread and the encoder (power of two). When the ring
+// is full new frames are dropped, the render thread never waits for the encoder.
+#define RECORD_RING_SIZE 8
+
+// How long the encoder sleeps when it finds the ring empty
+#define RECORD_POLL_USEC 4000
+
+// Session file layout, all fields little endian:
+//   header  "S2DV", version, width, height, pixel format      (5 x uint32)
+//   frame   frame ID, capture time in usec, payload bytes    (uint32, uint64, uint32)
+//   payload runs of { uint16 unchanged, uint16 changed, uint32 pixels[changed] } against the
+//           previous frame (all zero before the first), until the runs cover the frame
+#define RECORD_FILE_MAGIC 0x56443253u
+#define RECORD_FILE_VERSION 1
+
+// Counters for the current session. Captures count from Start, the encoder side from when
+// the session's file is opened, once the previous session has finished writing.
+struct RecorderStats {
+    uint32_t captured;
+    uint32_t dropped;       // Ring was full
+    uint32_t encoded;
+    uint64_t bytesWritten;
+};
+
+// Records rendered frames to a delta-compressed stream. Capture runs on the render thread and
+// only ever touches its side of a single-producer single-consumer ring of preallocated frames;
+// a low-priority encoder thread owns the other side and the file.
+class Recorder {
+public:
+    Recorder();
+    ~Recorder();
+    
+    // Preallocates the ring for the scene's drawing size and starts the encoder
+    bool Init(Scene2D* scene);
+    void Shutdown();
+    
+    // Sessions go to a new file each, frames still in the ring are written before it closes
+    void Start();
+    void Stop();
+    bool IsRecording();
+    
+    // Called once per rendered frame, between QueueFrame and FrameBufferSwap. Returns true
+    // if this frame was captured.
+    bool CaptureFrame(Scene2D* scene, int frameID);
+    
+    RecorderStats GetStats();
+
+private:
+    struct Slot {
+        uint32_t* pixels;
+        uint32_t frameID;
+        uint64_t time;
+        unsigned int session;
+    };
+    
+    static void* encoderThread(void* arg);
+    bool openFile(unsigned int session);
+    void closeFile();
+    void encodeFrame(const Slot* slot);
+    
+    Slot ring[RECORD_RING_SIZE];
+    std::atomic<unsigned int> writeIndex;   // Advanced by the render thread only
+    std::atomic<unsigned int> readIndex;    // Advanced by the encoder only
+    
+    int width;
+    int height;
+    PixelFormat format;
+    
+    // Render thread state. The session it captures for is 0 while stopped, the encoder
+    // closes a session's file once it is no longer the active one.
+    std::atomic<unsigned int> activeSession;
+    unsigned int nextSession;
+    unsigned int frameCounter;
+    
+    // Encoder state
+    FILE* file;
+    unsigned int fileSession;
+    uint32_t* previous;
+    uint8_t* output;
+    
+    std::atomic<uint32_t> captured;
+    std::atomic<uint32_t> dropped;
+    std::atomic<uint32_t> encoded;
+    std::atomic<uint64_t> bytesWritten;
+    
+    pthread_t thread;
+    std::atomic<bool> quitting;
+    bool started;
+};
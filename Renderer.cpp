@@ -1,30 +1,60 @@
 #include "Renderer.h"
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
 
 // Tile dimensions and positions
 #define TILE_SIZE 150
 #define TILE_PADDING 20
 #define GRID_START_X 560    
 #define GRID_START_Y 240
+#define TILE_RADIUS 8
 
-// Color definitions
-static Color bgColor = { 0xFA, 0xF8, 0xEF, 0xFF };
-static Color emptyTileColor = { 0xCD, 0xC1, 0xB4, 0xFF };
-static Color tile2Color = { 0xEE, 0xE4, 0xDA, 0xFF };
-static Color tile4Color = { 0xED, 0xE0, 0xC8, 0xFF };
-static Color tile8Color = { 0xF2, 0xB1, 0x79, 0xFF };
-static Color tile16Color = { 0xF5, 0x95, 0x63, 0xFF };
-static Color tile32Color = { 0xF6, 0x7C, 0x5F, 0xFF };
-static Color tile64Color = { 0xF6, 0x5E, 0x3B, 0xFF };
-static Color tile128Color = { 0xED, 0xCF, 0x72, 0xFF };
-static Color tile256Color = { 0xED, 0xCC, 0x61, 0xFF };
-static Color tile512Color = { 0xED, 0xC8, 0x50, 0xFF };
-static Color tile1024Color = { 0xED, 0xC5, 0x3F, 0xFF };
-static Color tile2048Color = { 0xED, 0xC2, 0x2E, 0xFF };
-static Color darkTextColor = { 0x77, 0x6E, 0x65, 0xFF };
-static Color lightTextColor = { 0xF9, 0xF6, 0xF2, 0xFF };
-static Color menuHighlightColor = { 0xF6, 0x7C, 0x5F, 0xFF };
+// Merge bursts, sizes and speeds in layout units
+#define PARTICLE_SIZE 8
+#define PARTICLE_SPEED 900
+#define PARTICLE_LIFE_SEC 0.6f
+#define MERGE_PARTICLES_BASE 24
+#define MERGE_PARTICLES_PER_DOUBLING 8
+
+// Themes read from the theme file, or just the built-in classic one
+Theme Renderer::themes[THEME_MAX_COUNT];
+std::atomic<int> Renderer::themeCount(0);
+int Renderer::currentTheme = -1;
+const char* Renderer::themeFilePath = nullptr;
+int64_t Renderer::themeFileTime = 0;
+uint64_t Renderer::themeCheckTime = 0;
+
+// Current theme in the frame buffer's native pixel format
+Pixel Renderer::palette[PAL_COUNT];
+Pixel Renderer::tileColors[TILE_SPRITE_COUNT];
+Pixel Renderer::tileTextColors[TILE_SPRITE_COUNT];
+
+// Glyph table over the bitmaps below, recorded as glyph runs
+BitmapFont Renderer::font;
+
+// Mapping from layout units to scene pixels
+int Renderer::layoutScale = 1 << 16;
+int Renderer::layoutOffsetX = 0;
+int Renderer::layoutOffsetY = 0;
+int Renderer::screenWidth = LAYOUT_WIDTH;
+int Renderer::screenHeight = LAYOUT_HEIGHT;
+int Renderer::tileSizePx = TILE_SIZE;
+int Renderer::tileRadiusPx = TILE_RADIUS;
+
+// Tiles pre-rendered with the current palette, drawn as sprites
+Surface Renderer::tileSprites[TILE_SPRITE_COUNT];
+
+// Static screen layers, rebuilt when their key or the palette changes
+Surface Renderer::layers[LAYER_COUNT];
+uint64_t Renderer::layerKeys[LAYER_COUNT];
+bool Renderer::layerValid[LAYER_COUNT];
+
+ParticleSystem Renderer::particles;
+unsigned int Renderer::particleMoveID = 0;
+uint64_t Renderer::particleTime = 0;
+bool Renderer::layerTargetSet = false;
 
 // Simple 5x7 bitmap font for digits 0-9
 static const uint8_t digitBitmaps[10][7] = {
@@ -70,108 +100,199 @@ static const uint8_t letterBitmaps[26][7] = {
     {0x1F, 0x02, 0x04, 0x08, 0x1F}  // Z
 };
 
-void Renderer::Init() {
-    // Nothing to initialize yet
-}
-
-void Renderer::drawChar(Scene2D* scene, char c, int x, int y, Color color, int scale) {
-    if (c >= '0' && c <= '9') {
-        int digit = c - '0';
-        for (int row = 0; row < 5; row++) {
-            for (int col = 0; col < 5; col++) {
-                if (digitBitmaps[digit][row] & (1 << (4 - col))) {
-                    for (int sy = 0; sy < scale; sy++) {
-                        for (int sx = 0; sx < scale; sx++) {
-                            scene->DrawPixel(x + col * scale + sx, y + row * scale + sy, color);
-                        }
-                    }
-                }
-            }
-        }
-    } else if (c >= 'A' && c <= 'Z') {
-        int letter = c - 'A';
-        for (int row = 0; row < 5; row++) {
-            for (int col = 0; col < 5; col++) {
-                if (letterBitmaps[letter][row] & (1 << (4 - col))) {
-                    for (int sy = 0; sy < scale; sy++) {
-                        for (int sx = 0; sx < scale; sx++) {
-                            scene->DrawPixel(x + col * scale + sx, y + row * scale + sy, color);
-                        }
-                    }
-                }
-            }
-        }
-    } else if (c >= 'a' && c <= 'z') {
-        drawChar(scene, c - 32, x, y, color, scale);
+void Renderer::Init(Scene2D* scene) {
+    // Lowercase letters share the uppercase glyphs, everything else is blank
+    memset(&font, 0, sizeof(font));
+    font.glyphWidth = 5;
+    font.glyphHeight = 5;
+    font.advance = 6;
+    
+    for (int i = 0; i < 10; i++) {
+        font.glyphs['0' + i] = digitBitmaps[i];
+    }
+    
+    for (int i = 0; i < 26; i++) {
+        font.glyphs['A' + i] = letterBitmaps[i];
+        font.glyphs['a' + i] = letterBitmaps[i];
     }
+    
+    setLayout(scene->GetWidth(), scene->GetHeight());
+    loadThemes();
+    applyTheme(scene, 0);
 }
 
-void Renderer::DrawText(Scene2D* scene, const char* text, int x, int y, Color color, int scale) {
-    int xOffset = 0;
-    for (int i = 0; text[i] != '\0'; i++) {
-        drawChar(scene, text[i], x + xOffset, y, color, scale);
-        xOffset += (6 * scale);
-    }
+void Renderer::setLayout(int width, int height) {
+    // Uniform scale that fits the layout canvas, the leftover axis is centred
+    int scaleX = (int)(((int64_t)width << 16) / LAYOUT_WIDTH);
+    int scaleY = (int)(((int64_t)height << 16) / LAYOUT_HEIGHT);
+    
+    layoutScale = scaleX < scaleY ? scaleX : scaleY;
+    screenWidth = width;
+    screenHeight = height;
+    layoutOffsetX = (width - pxSize(LAYOUT_WIDTH)) / 2;
+    layoutOffsetY = (height - pxSize(LAYOUT_HEIGHT)) / 2;
+    
+    tileSizePx = pxSize(TILE_SIZE);
+    tileRadiusPx = pxSize(TILE_RADIUS);
+}
+
+int Renderer::pxSize(int size) {
+    return (int)(((int64_t)size * layoutScale + 0x8000) >> 16);
+}
+
+int Renderer::pxX(int x) {
+    return layoutOffsetX + pxSize(x);
+}
+
+int Renderer::pxY(int y) {
+    return layoutOffsetY + pxSize(y);
+}
+
+int Renderer::pxTextScale(int scale) {
+    // Bitmap glyphs only scale by whole pixels
+    int s = pxSize(scale);
+    return s < 1 ? 1 : s;
 }
 
-void Renderer::drawDigit(Scene2D* scene, int digit, int x, int y, Color color, int scale) {
-    if (digit < 0 || digit > 9) return;
+void Renderer::loadThemes() {
+    themeFilePath = ThemeFile::FindPath();
+    themeFileTime = ThemeFile::GetModifiedTime(themeFilePath);
     
-    for (int row = 0; row < 5; row++) {
-        for (int col = 0; col < 5; col++) {
-            if (digitBitmaps[digit][row] & (1 << (4 - col))) {
-                for (int sy = 0; sy < scale; sy++) {
-                    for (int sx = 0; sx < scale; sx++) {
-                        scene->DrawPixel(x + col * scale + sx, y + row * scale + sy, color);
-                    }
-                }
-            }
-        }
+    int count = ThemeFile::Load(themeFilePath, themes, THEME_MAX_COUNT);
+    if (count == 0) {
+        ThemeFile::GetClassic(&themes[0]);
+        count = 1;
     }
+    
+    themeCount = count;
 }
 
-void Renderer::DrawNumber(Scene2D* scene, int number, int x, int y, Color color, int scale) {
-    if (number == 0) {
-        drawDigit(scene, 0, x, y, color, scale);
-        return;
+void Renderer::applyTheme(Scene2D* scene, int index) {
+    if (index < 0 || index >= themeCount) index = 0;
+    
+    const Theme* theme = &themes[index];
+    currentTheme = index;
+    
+    for (int i = 0; i < PAL_COUNT; i++) {
+        palette[i] = scene->EncodeColor(theme->colors[i]);
     }
     
-    char buffer[16];
-    snprintf(buffer, sizeof(buffer), "%d", number);
-    int len = strlen(buffer);
+    for (int i = 0; i < TILE_SPRITE_COUNT; i++) {
+        tileColors[i] = scene->EncodeColor(theme->tileColors[i]);
+        tileTextColors[i] = scene->EncodeColor(theme->tileTextColors[i]);
+    }
     
-    int totalWidth = len * (5 * scale + scale);
-    int startX = x - totalWidth / 2;
+    // Tile sprites and screen layers bake in theme colors, nothing else is cached
+    buildTileSprites(scene);
     
-    for (int i = 0; i < len; i++) {
-        int digit = buffer[i] - '0';
-        drawDigit(scene, digit, startX + i * (5 * scale + scale), y, color, scale);
+    for (int i = 0; i < LAYER_COUNT; i++) {
+        layerValid[i] = false;
     }
 }
 
-Color Renderer::getTileColor(int value) {
-    switch(value) {
-        case 0: return emptyTileColor;
-        case 2: return tile2Color;
-        case 4: return tile4Color;
-        case 8: return tile8Color;
-        case 16: return tile16Color;
-        case 32: return tile32Color;
-        case 64: return tile64Color;
-        case 128: return tile128Color;
-        case 256: return tile256Color;
-        case 512: return tile512Color;
-        case 1024: return tile1024Color;
-        case 2048: return tile2048Color;
-        default: return tile2048Color;
+void Renderer::SetTheme(Scene2D* scene, int index) {
+    // Out of range picks fall back to the first theme rather than rebuilding every frame
+    if (index < 0 || index >= themeCount) index = 0;
+    if (index == currentTheme) return;
+    
+    applyTheme(scene, index);
+}
+
+int Renderer::GetThemeCount() {
+    return themeCount;
+}
+
+const char* Renderer::GetThemeName(int index) {
+    if (index < 0 || index >= themeCount) index = 0;
+    
+    return themes[index].name;
+}
+
+bool Renderer::ReloadThemes(Scene2D* scene, uint64_t now) {
+    if (now - themeCheckTime < THEME_RELOAD_CHECK_USEC) return false;
+    themeCheckTime = now;
+    
+    // Adding or removing an override switches files even when the times happen to match
+    const char* path = ThemeFile::FindPath();
+    if (path == themeFilePath && ThemeFile::GetModifiedTime(path) == themeFileTime) return false;
+    
+    printf("[INFO] Theme file %s changed, reloading\n", path);
+    loadThemes();
+    applyTheme(scene, currentTheme);
+    return true;
+}
+
+void Renderer::buildTileSprites(Scene2D* scene) {
+    for (int i = 0; i < TILE_SPRITE_COUNT; i++) {
+        Surface* sprite = &tileSprites[i];
+        
+        if (!sprite->pixels && !scene->CreateSurface(sprite, tileSizePx, tileSizePx)) continue;
+        
+        int value = (i == 0) ? 0 : (1 << i);
+        
+        // Corners outside the rounded tile stay transparent
+        scene->SetRenderTarget(sprite);
+        scene->DrawRectangle(0, 0, tileSizePx, tileSizePx, 0);
+        drawTileContent(scene, 0, 0, tileSizePx, value);
+        
+        // Switching back flushes the recorded tile into the sprite
+        scene->SetRenderTarget(NULL);
     }
 }
 
-Color Renderer::getTextColor(int value) {
-    if (value >= 8) {
-        return lightTextColor;
+// Returns true when the layer's static content has to be drawn. That content is redirected
+// into the layer surface, or straight to the frame if the surface couldn't be allocated.
+bool Renderer::beginLayer(Scene2D* scene, ScreenLayer layer, uint64_t key) {
+    Surface* surface = &layers[layer];
+    
+    if (layerValid[layer] && layerKeys[layer] == key) return false;
+    
+    if (!surface->pixels && !scene->CreateSurface(surface, screenWidth, screenHeight)) return true;
+    
+    layerKeys[layer] = key;
+    layerValid[layer] = true;
+    
+    scene->SetRenderTarget(surface);
+    layerTargetSet = true;
+    return true;
+}
+
+void Renderer::endLayer(Scene2D* scene) {
+    if (!layerTargetSet) return;
+    
+    scene->SetRenderTarget(NULL);
+    layerTargetSet = false;
+}
+
+void Renderer::drawLayer(Scene2D* scene, ScreenLayer layer) {
+    const Surface* surface = &layers[layer];
+    if (!surface->pixels || !layerValid[layer]) return;
+    
+    // Full-width aligned row copies, and unchanged bands are skipped by the diff
+    scene->Blit(surface, 0, 0);
+}
+
+void Renderer::DrawText(Scene2D* scene, const char* text, int x, int y, Pixel color, int scale, TextAlign align) {
+    drawTextPx(scene, text, pxX(x), pxY(y), color, pxTextScale(scale), align);
+}
+
+void Renderer::DrawNumber(Scene2D* scene, int number, int x, int y, Pixel color, int scale, TextAlign align) {
+    drawNumberPx(scene, number, pxX(x), pxY(y), color, pxTextScale(scale), align);
+}
+
+void Renderer::drawTextPx(Scene2D* scene, const char* text, int x, int y, Pixel color, int scale, TextAlign align) {
+    int length = strlen(text);
+    
+    if (align != ALIGN_LEFT) {
+        x = TextLayout::AlignX(x, TextLayout::Measure(&font, length, scale), align);
     }
-    return darkTextColor;
+    
+    scene->DrawGlyphRun(&font, text, length, x, y, scale, color);
+}
+
+void Renderer::drawNumberPx(Scene2D* scene, int number, int x, int y, Pixel color, int scale, TextAlign align) {
+    const TextRun* run = TextLayout::Number(&font, number, scale);
+    scene->DrawGlyphRun(&font, run->text, run->length, TextLayout::AlignX(x, run->width, align), y, scale, color);
 }
 
 int Renderer::getNumberScale(int value) {
@@ -180,105 +301,298 @@ int Renderer::getNumberScale(int value) {
     return 5;
 }
 
-void Renderer::DrawTile(Scene2D* scene, int row, int col, int value) {
-    int x = GRID_START_X + col * (TILE_SIZE + TILE_PADDING);
-    int y = GRID_START_Y + row * (TILE_SIZE + TILE_PADDING);
+int Renderer::getTileIndex(int value) {
+    // Tile values are powers of two, the index is the exponent
+    if (value <= 1) return 0;
     
-    Color tileColor = getTileColor(value);
-    scene->DrawRectangle(x, y, TILE_SIZE, TILE_SIZE, tileColor);
+    int index = 31 - __builtin_clz((unsigned int)value);
+    return index < TILE_SPRITE_COUNT ? index : TILE_SPRITE_COUNT - 1;
+}
+
+int Renderer::cellX(int col) {
+    return GRID_START_X + col * (TILE_SIZE + TILE_PADDING);
+}
+
+int Renderer::cellY(int row) {
+    return GRID_START_Y + row * (TILE_SIZE + TILE_PADDING);
+}
+
+void Renderer::drawTileContent(Scene2D* scene, int x, int y, int size, int value) {
+    int index = getTileIndex(value);
+    scene->DrawRoundedRectangle(x, y, size, size, tileRadiusPx, tileColors[index]);
     
     if (value > 0) {
-        Color textColor = getTextColor(value);
-        int scale = getNumberScale(value);
-        int centerX = x + TILE_SIZE / 2;
-        int centerY = y + TILE_SIZE / 2 - (5 * scale) / 2;
-        DrawNumber(scene, value, centerX, centerY, textColor, scale);
+        int scale = pxTextScale(getNumberScale(value));
+        drawNumberPx(scene, value, x + size / 2, y + size / 2 - (5 * scale) / 2, tileTextColors[index], scale, ALIGN_CENTER);
     }
 }
 
-void Renderer::DrawMenu(Scene2D* scene, int menuSelection, int highScore) {
-    scene->FrameBufferFill(bgColor);
+void Renderer::drawTileAt(Scene2D* scene, int x, int y, int size, int value) {
+    int index = getTileIndex(value);
+    const Surface* sprite = &tileSprites[index];
     
-    DrawNumber(scene, 2048, 960, 200, darkTextColor, 16);
+    // Scaled tiles stay centred on the cell they belong to
+    int tile = tileSizePx;
+    int radius = tileRadiusPx;
+    int sizePx = (size == TILE_SIZE) ? tile : pxSize(size);
+    int offset = (tile - sizePx) / 2;
     
-    Color startColor = (menuSelection == 0) ? menuHighlightColor : darkTextColor;
-    DrawText(scene, "START GAME", 760, 450, startColor, 6);
+    x = pxX(x);
+    y = pxY(y);
     
-    Color settingsColor = (menuSelection == 1) ? menuHighlightColor : darkTextColor;
-    DrawText(scene, "SETTINGS", 820, 550, settingsColor, 6);
+    // No room for the sprite in surface memory, draw the tile from scratch
+    if (!sprite->pixels) {
+        drawTileContent(scene, x + offset, y + offset, sizePx, value);
+        return;
+    }
     
-    DrawText(scene, "HIGH SCORE", 740, 700, darkTextColor, 5);
-    DrawNumber(scene, highScore, 960, 770, darkTextColor, 5);
+    if (sizePx != tile) {
+        scene->DrawBlendedSprite(sprite->pixels, sprite->pitch, sprite->width, sprite->height, sprite->contentID, x + offset, y + offset, sizePx, sizePx);
+        return;
+    }
     
-    DrawText(scene, "CREATED BY SKIDGFX", 744, 950, darkTextColor, 4);
-    DrawText(scene, "X SELECT  UP DOWN NAVIGATE  SQUARE QUIT", 600, 1030, darkTextColor, 3);
+    // Only the rows holding rounded corners need blending, the rest is a straight copy
+    scene->BlitBlend(sprite, 0, 0, tile, radius, x, y);
+    scene->Blit(sprite, 0, radius, tile, tile - 2 * radius, x, y + radius);
+    scene->BlitBlend(sprite, 0, tile - radius, tile, radius, x, y + tile - radius);
 }
 
-void Renderer::DrawSettings(Scene2D* scene, int settingsSelection, int audioVolume) {
-    scene->FrameBufferFill(bgColor);
+// Background and tiles only, the still board under the game over overlay
+void Renderer::drawBoard(Scene2D* scene, const int grid[4][4]) {
+    scene->FrameBufferFill(palette[PAL_BACKGROUND]);
     
-    DrawText(scene, "SETTINGS", 820, 150, darkTextColor, 8);
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            DrawTile(scene, i, j, grid[i][j]);
+        }
+    }
+}
+
+void Renderer::DrawTile(Scene2D* scene, int row, int col, int value) {
+    drawTileAt(scene, cellX(col), cellY(row), TILE_SIZE, value);
+}
+
+void Renderer::DrawMenu(Scene2D* scene, int menuSelection, int highScore) {
+    if (beginLayer(scene, LAYER_MENU, 0)) {
+        scene->FrameBufferFill(palette[PAL_BACKGROUND]);
+        
+        DrawNumber(scene, 2048, 960, 200, palette[PAL_DARK_TEXT], 16, ALIGN_CENTER);
+        DrawText(scene, "HIGH SCORE", 960, 700, palette[PAL_DARK_TEXT], 5, ALIGN_CENTER);
+        DrawText(scene, "CREATED BY SKIDGFX", 960, 950, palette[PAL_DARK_TEXT], 4, ALIGN_CENTER);
+        DrawText(scene, "X SELECT  UP DOWN NAVIGATE  SQUARE QUIT", 960, 1030, palette[PAL_DARK_TEXT], 3, ALIGN_CENTER);
+        
+        endLayer(scene);
+    }
+    
+    drawLayer(scene, LAYER_MENU);
     
-    Color volumeColor = (settingsSelection == 0) ? menuHighlightColor : darkTextColor;
-    DrawText(scene, "VOLUME", 700, 350, volumeColor, 6);
+    Pixel startColor = (menuSelection == 0) ? palette[PAL_MENU_HIGHLIGHT] : palette[PAL_DARK_TEXT];
+    DrawText(scene, "START GAME", 960, 450, startColor, 6, ALIGN_CENTER);
     
+    Pixel settingsColor = (menuSelection == 1) ? palette[PAL_MENU_HIGHLIGHT] : palette[PAL_DARK_TEXT];
+    DrawText(scene, "SETTINGS", 960, 550, settingsColor, 6, ALIGN_CENTER);
+    
+    DrawNumber(scene, highScore, 960, 770, palette[PAL_DARK_TEXT], 5, ALIGN_CENTER);
+}
+
+void Renderer::DrawSettings(Scene2D* scene, int settingsSelection, int audioVolume, int theme) {
     // Volume bar
     int barX = 600;
     int barY = 450;
     int barWidth = 720;
     int barHeight = 40;
     
-    scene->DrawRectangle(barX, barY, barWidth, barHeight, emptyTileColor);
+    if (beginLayer(scene, LAYER_SETTINGS, 0)) {
+        scene->FrameBufferFill(palette[PAL_BACKGROUND]);
+        
+        DrawText(scene, "SETTINGS", 960, 150, palette[PAL_DARK_TEXT], 8, ALIGN_CENTER);
+        scene->DrawRectangle(pxX(barX), pxY(barY), pxSize(barWidth), pxSize(barHeight), tileColors[0]);
+        DrawText(scene, "%", 1450, 455, palette[PAL_DARK_TEXT], 5, ALIGN_LEFT);
+        DrawText(scene, "X SELECT  UP DOWN NAVIGATE  LEFT RIGHT ADJUST", 960, 1030, palette[PAL_DARK_TEXT], 3, ALIGN_CENTER);
+        
+        endLayer(scene);
+    }
+    
+    drawLayer(scene, LAYER_SETTINGS);
+    
+    Pixel volumeColor = (settingsSelection == 0) ? palette[PAL_MENU_HIGHLIGHT] : palette[PAL_DARK_TEXT];
+    DrawText(scene, "VOLUME", 700, 350, volumeColor, 6, ALIGN_LEFT);
     
     int fillWidth = (barWidth * audioVolume) / 100;
     if (fillWidth > 0) {
-        scene->DrawRectangle(barX, barY, fillWidth, barHeight, menuHighlightColor);
+        scene->DrawRectangle(pxX(barX), pxY(barY), pxSize(fillWidth), pxSize(barHeight), palette[PAL_MENU_HIGHLIGHT]);
     }
     
-    char volBuf[16];
-    snprintf(volBuf, sizeof(volBuf), "%d", audioVolume);
-    DrawText(scene, volBuf, 1350, 455, darkTextColor, 5);
-    DrawText(scene, "%", 1450, 455, darkTextColor, 5);
+    DrawNumber(scene, audioVolume, 1435, 455, palette[PAL_DARK_TEXT], 5, ALIGN_RIGHT);
     
-    Color backColor = (settingsSelection == 1) ? menuHighlightColor : darkTextColor;
-    DrawText(scene, "BACK", 880, 650, backColor, 6);
+    Pixel themeColor = (settingsSelection == 1) ? palette[PAL_MENU_HIGHLIGHT] : palette[PAL_DARK_TEXT];
+    DrawText(scene, "THEME", 700, 600, themeColor, 6, ALIGN_LEFT);
+    DrawText(scene, GetThemeName(theme), 1000, 600, palette[PAL_DARK_TEXT], 6, ALIGN_LEFT);
     
-    DrawText(scene, "X SELECT  UP DOWN NAVIGATE  LEFT RIGHT ADJUST", 546, 1030, darkTextColor, 3);
+    Pixel backColor = (settingsSelection == 2) ? palette[PAL_MENU_HIGHLIGHT] : palette[PAL_DARK_TEXT];
+    DrawText(scene, "BACK", 960, 750, backColor, 6, ALIGN_CENTER);
 }
 
-void Renderer::DrawGame(Scene2D* scene, int grid[4][4], int score) {
-    scene->FrameBufferFill(bgColor);
+void Renderer::DrawGame(Scene2D* scene, const int grid[4][4], int score, const BoardMove* move, uint64_t now) {
+    scene->FrameBufferFill(palette[PAL_BACKGROUND]);
     
-    DrawNumber(scene, 2048, 960, 100, darkTextColor, 8);
-    DrawNumber(scene, score, 960, 180, darkTextColor, 5);
+    DrawNumber(scene, 2048, 960, 100, palette[PAL_DARK_TEXT], 8, ALIGN_CENTER);
+    DrawNumber(scene, score, 960, 180, palette[PAL_DARK_TEXT], 5, ALIGN_CENTER);
     
+    bool animating = move && move->motionCount > 0 && now < move->startTime + TILE_ANIM_USEC;
+    
+    if (animating && now < move->startTime + TILE_SLIDE_USEC) {
+        // Slide: empty cells stay put while every tile travels from its source to its destination
+        float t = EaseOutQuad(AnimationProgress(now, move->startTime, TILE_SLIDE_USEC));
+        
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                DrawTile(scene, i, j, 0);
+            }
+        }
+        
+        for (int m = 0; m < move->motionCount; m++) {
+            const TileMotion* motion = &move->motions[m];
+            int fromX = cellX(motion->fromCol);
+            int fromY = cellY(motion->fromRow);
+            int x = fromX + (int)((cellX(motion->toCol) - fromX) * t);
+            int y = fromY + (int)((cellY(motion->toRow) - fromY) * t);
+            drawTileAt(scene, x, y, TILE_SIZE, motion->value);
+        }
+    } else {
+        for (int i = 0; i < 4; i++) {
+            for (int j = 0; j < 4; j++) {
+                bool spawned = animating && i == move->spawnRow && j == move->spawnCol;
+                DrawTile(scene, i, j, spawned ? 0 : grid[i][j]);
+            }
+        }
+        
+        if (animating) {
+            // Pop: merged tiles pulse and the new tile grows in, drawn last so they overlap neighbours
+            float t = AnimationProgress(now, move->startTime + TILE_SLIDE_USEC, TILE_POP_USEC);
+            int pulseSize = (int)(TILE_SIZE * (1.0f + 0.2f * sinf(t * (float)M_PI)));
+            
+            for (int m = 0; m < move->motionCount; m++) {
+                const TileMotion* motion = &move->motions[m];
+                if (!motion->merged) continue;
+                
+                int row = motion->toRow;
+                int col = motion->toCol;
+                drawTileAt(scene, cellX(col), cellY(row), pulseSize, grid[row][col]);
+            }
+            
+            if (move->spawnRow >= 0) {
+                int row = move->spawnRow;
+                int col = move->spawnCol;
+                drawTileAt(scene, cellX(col), cellY(row), (int)(TILE_SIZE * EaseOutQuad(t)), grid[row][col]);
+            }
+        }
+    }
+    
+    if (move) {
+        updateParticles(grid, move, now);
+        particles.Draw(scene, pxSize(PARTICLE_SIZE));
+    }
+    
+    DrawText(scene, "DPAD ANALOG SWIPE  OPTIONS RESTART  X MENU", 960, 950, palette[PAL_DARK_TEXT], 3, ALIGN_CENTER);
+}
+
+bool Renderer::IsAnimating(const BoardMove* move, uint64_t now) {
+    if (particles.GetCount() > 0) return true;
+    if (move->motionCount == 0) return false;
+    
+    // Tiles still sliding or popping, or a merge burst that hasn't been spawned yet
+    return now < move->startTime + TILE_ANIM_USEC || move->id != particleMoveID;
+}
+
+void Renderer::updateParticles(const int grid[4][4], const BoardMove* move, uint64_t now) {
+    float dt = (particleTime != 0 && now > particleTime) ? (float)(now - particleTime) / 1000000.0f : 0.0f;
+    particleTime = now;
+    
+    // A long gap (paused, another screen) shouldn't fling particles across the board
+    if (dt > 0.1f) particles.Clear();
+    else particles.Update(dt);
+    
+    // Each move bursts once, as its tiles land and the merged ones start to pop
+    if (move->id == particleMoveID || now < move->startTime + TILE_SLIDE_USEC) return;
+    particleMoveID = move->id;
+    
+    for (int m = 0; m < move->motionCount; m++) {
+        const TileMotion* motion = &move->motions[m];
+        if (!motion->merged) continue;
+        
+        int row = motion->toRow;
+        int col = motion->toCol;
+        int value = grid[row][col];
+        int count = MERGE_PARTICLES_BASE;
+        
+        for (int v = value; v > 2; v >>= 1) count += MERGE_PARTICLES_PER_DOUBLING;
+        
+        float x = (float)pxX(cellX(col) + TILE_SIZE / 2);
+        float y = (float)pxY(cellY(row) + TILE_SIZE / 2);
+        particles.Emit(x, y, count, (float)pxSize(PARTICLE_SPEED), PARTICLE_LIFE_SEC, tileColors[getTileIndex(value)]);
+    }
+}
+
+void Renderer::DrawGameOver(Scene2D* scene, const int grid[4][4], int score, int highScore, bool hasWon) {
+    // The layer holds the final board faded out behind the results, so it is keyed on that board
+    uint64_t key = 14695981039346656037ull;
     for (int i = 0; i < 4; i++) {
         for (int j = 0; j < 4; j++) {
-            DrawTile(scene, i, j, grid[i][j]);
+            key = (key ^ (uint32_t)grid[i][j]) * 1099511628211ull;
         }
     }
+    key = (key ^ (hasWon ? 1 : 0)) * 1099511628211ull;
     
-    DrawText(scene, "DPAD ANALOG SWIPE  OPTIONS RESTART  X MENU", 573, 950, darkTextColor, 3);
+    if (beginLayer(scene, LAYER_GAME_OVER, key)) {
+        drawBoard(scene, grid);
+        scene->DrawBlendedRectangle(0, 0, screenWidth, screenHeight, palette[PAL_OVERLAY]);
+        
+        DrawNumber(scene, 2048, 960, 100, palette[PAL_DARK_TEXT], 8, ALIGN_CENTER);
+        DrawText(scene, "FINAL SCORE", 960, 300, palette[PAL_DARK_TEXT], 6, ALIGN_CENTER);
+        DrawText(scene, "HIGH SCORE", 960, 520, palette[PAL_DARK_TEXT], 5, ALIGN_CENTER);
+        
+        if (hasWon) {
+            DrawText(scene, "YOU WIN", 960, 700, palette[PAL_WIN_TEXT], 7, ALIGN_CENTER);
+        } else {
+            DrawText(scene, "GAME OVER", 960, 700, palette[PAL_LOSE_TEXT], 7, ALIGN_CENTER);
+        }
+        
+        DrawText(scene, "TRIANGLE OR CIRCLE TO MENU", 960, 850, palette[PAL_DARK_TEXT], 4, ALIGN_CENTER);
+        DrawText(scene, "OPTIONS TO RESTART", 960, 920, palette[PAL_DARK_TEXT], 4, ALIGN_CENTER);
+        DrawText(scene, "X TO MENU", 960, 990, palette[PAL_DARK_TEXT], 4, ALIGN_CENTER);
+        
+        endLayer(scene);
+    }
+    
+    drawLayer(scene, LAYER_GAME_OVER);
+    
+    DrawNumber(scene, score, 960, 380, palette[PAL_DARK_TEXT], 8, ALIGN_CENTER);
+    DrawNumber(scene, highScore, 960, 590, palette[PAL_DARK_TEXT], 5, ALIGN_CENTER);
 }
 
-void Renderer::DrawGameOver(Scene2D* scene, int score, int highScore, bool hasWon) {
-    scene->FrameBufferFill(bgColor);
+void Renderer::DrawProfiler(Scene2D* scene, const ProfilerStats& stats) {
+    static const char* labels[PHASE_COUNT] = { "UPDATE", "RENDER", "RESOLVE", "FLIP", "WAIT", "RECORD" };
+    char line[32];
+    int y = 32;
     
-    DrawNumber(scene, 2048, 960, 100, darkTextColor, 8);
+    // A handful of glyph runs over one blended rect keeps the overlay far below 0.1 ms
+    scene->DrawBlendedRectangle(pxX(20), pxY(20), pxSize(220), pxSize(180), palette[PAL_PROFILER_PANEL]);
     
-    DrawText(scene, "FINAL SCORE", 720, 300, darkTextColor, 6);
-    DrawNumber(scene, score, 960, 380, darkTextColor, 8);
+    // Long readings are cut at the panel edge instead of spilling over the board
+    scene->PushClipRect(pxX(20), pxY(20), pxSize(220), pxSize(180));
     
-    DrawText(scene, "HIGH SCORE", 740, 520, darkTextColor, 5);
-    DrawNumber(scene, highScore, 960, 590, darkTextColor, 5);
-    
-    if (hasWon) {
-        DrawText(scene, "YOU WIN", 810, 700, tile128Color, 7);
-    } else {
-        DrawText(scene, "GAME OVER", 750, 700, tile32Color, 7);
+    for (int i = 0; i < PHASE_COUNT; i++, y += 20) {
+        snprintf(line, sizeof(line), "%s %u US", labels[i], stats.phaseUsec[i]);
+        DrawText(scene, line, 32, y, palette[PAL_LIGHT_TEXT], 2, ALIGN_LEFT);
     }
     
-    DrawText(scene, "TRIANGLE OR CIRCLE TO MENU", 636, 850, darkTextColor, 4);
-    DrawText(scene, "OPTIONS TO RESTART", 744, 920, darkTextColor, 4);
-    DrawText(scene, "X TO MENU", 852, 990, darkTextColor, 4);
+    snprintf(line, sizeof(line), "FPS %u", stats.fps);
+    DrawText(scene, line, 32, y, palette[PAL_LIGHT_TEXT], 2, ALIGN_LEFT);
+    y += 20;
+    
+    snprintf(line, sizeof(line), "WORST %u US", stats.worstFrameUsec);
+    DrawText(scene, line, 32, y, palette[PAL_LIGHT_TEXT], 2, ALIGN_LEFT);
+    
+    scene->PopClipRect();
 }
@@ -1,29 +1,125 @@
 #pragma once
 
 #include "graphics.h"
+#include "Animation.h"
+#include "Profiler.h"
+#include "Particles.h"
+#include "Theme.h"
+#include "TextLayout.h"
+#include <atomic>
+
+// Screens are laid out in virtual units on this reference canvas, then scaled uniformly
+// (and centred) to whatever resolution the scene draws at
+#define LAYOUT_WIDTH 1920
+#define LAYOUT_HEIGHT 1080
+
+// Cached tile sprites, one per tile exponent
+#define TILE_SPRITE_COUNT TILE_EXPONENT_COUNT
+
+// How often the theme file is checked for edits
+#define THEME_RELOAD_CHECK_USEC 1000000
+
+// Full-screen static layers, rendered once and copied under each frame's dynamic elements
+enum ScreenLayer {
+    LAYER_MENU,
+    LAYER_SETTINGS,
+    LAYER_GAME_OVER,
+    LAYER_COUNT
+};
 
 // Renderer class for all drawing operations
 class Renderer {
 public:
-    static void Init();
+    static void Init(Scene2D* scene);
+    
+    // Themes come from ThemeFile::FindPath, falling back to the built-in classic theme.
+    // Switching re-encodes the palette and rebuilds the cached sprites and layers.
+    static void SetTheme(Scene2D* scene, int index);
+    static int GetThemeCount();
+    static const char* GetThemeName(int index);
+    
+    // Re-reads the theme file if it changed since the last check, returns true when the
+    // current theme was reloaded and the screen needs redrawing
+    static bool ReloadThemes(Scene2D* scene, uint64_t now);
     
     // Screen drawing
     static void DrawMenu(Scene2D* scene, int menuSelection, int highScore);
-    static void DrawSettings(Scene2D* scene, int settingsSelection, int audioVolume);
-    static void DrawGame(Scene2D* scene, int grid[4][4], int score);
-    static void DrawGameOver(Scene2D* scene, int score, int highScore, bool hasWon);
+    static void DrawSettings(Scene2D* scene, int settingsSelection, int audioVolume, int theme);
+    static void DrawGame(Scene2D* scene, const int grid[4][4], int score, const BoardMove* move, uint64_t now);
+    
+    // True while DrawGame would draw something different at a later time with the same state
+    static bool IsAnimating(const BoardMove* move, uint64_t now);
+    static void DrawGameOver(Scene2D* scene, const int grid[4][4], int score, int highScore, bool hasWon);
     
-    // Primitive drawing
-    static void DrawText(Scene2D* scene, const char* text, int x, int y, Color color, int scale);
-    static void DrawNumber(Scene2D* scene, int number, int x, int y, Color color, int scale);
+    // Per-phase timings drawn over whatever screen is showing
+    static void DrawProfiler(Scene2D* scene, const ProfilerStats& stats);
+    
+    // Primitive drawing, coordinates and text scales are in layout units. Text is anchored
+    // on x according to align.
+    static void DrawText(Scene2D* scene, const char* text, int x, int y, Pixel color, int scale, TextAlign align);
+    static void DrawNumber(Scene2D* scene, int number, int x, int y, Pixel color, int scale, TextAlign align);
     static void DrawTile(Scene2D* scene, int row, int col, int value);
     
 private:
     Renderer() = delete;
     
-    static void drawChar(Scene2D* scene, char c, int x, int y, Color color, int scale);
-    static void drawDigit(Scene2D* scene, int digit, int x, int y, Color color, int scale);
-    static Color getTileColor(int value);
-    static Color getTextColor(int value);
     static int getNumberScale(int value);
+    static int getTileIndex(int value);
+    
+    // Layout units to scene pixels
+    static void setLayout(int width, int height);
+    static int pxX(int x);
+    static int pxY(int y);
+    static int pxSize(int size);
+    static int pxTextScale(int scale);
+    static void drawTextPx(Scene2D* scene, const char* text, int x, int y, Pixel color, int scale, TextAlign align);
+    static void drawNumberPx(Scene2D* scene, int number, int x, int y, Pixel color, int scale, TextAlign align);
+    
+    static void loadThemes();
+    static void applyTheme(Scene2D* scene, int index);
+    static void buildTileSprites(Scene2D* scene);
+    static void drawTileContent(Scene2D* scene, int x, int y, int size, int value);
+    static void drawTileAt(Scene2D* scene, int x, int y, int size, int value);
+    static void drawBoard(Scene2D* scene, const int grid[4][4]);
+    static int cellX(int col);
+    static int cellY(int row);
+    
+    static void updateParticles(const int grid[4][4], const BoardMove* move, uint64_t now);
+    
+    static bool beginLayer(Scene2D* scene, ScreenLayer layer, uint64_t key);
+    static void endLayer(Scene2D* scene);
+    static void drawLayer(Scene2D* scene, ScreenLayer layer);
+    
+    static Theme themes[THEME_MAX_COUNT];
+    static std::atomic<int> themeCount;     // Read by the logic thread to cycle themes
+    static int currentTheme;
+    static const char* themeFilePath;       // Which file the themes came from, see ThemeFile::FindPath
+    static int64_t themeFileTime;
+    static uint64_t themeCheckTime;
+    
+    // The current theme in native pixels
+    static Pixel palette[PAL_COUNT];
+    static Pixel tileColors[TILE_SPRITE_COUNT];
+    static Pixel tileTextColors[TILE_SPRITE_COUNT];
+    static BitmapFont font;
+    
+    static int layoutScale;         // 16.16 fixed point
+    static int layoutOffsetX;
+    static int layoutOffsetY;
+    static int screenWidth;
+    static int screenHeight;
+    static int tileSizePx;
+    static int tileRadiusPx;
+    
+    static Surface tileSprites[TILE_SPRITE_COUNT];
+    
+    // Merge bursts, fed from the merged motions of each new move
+    static ParticleSystem particles;
+    static unsigned int particleMoveID;
+    static uint64_t particleTime;
+    
+    static Surface layers[LAYER_COUNT];
+    static uint64_t layerKeys[LAYER_COUNT];
+    static bool layerValid[LAYER_COUNT];
+    static bool layerTargetSet;
 };
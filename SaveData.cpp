@@ -2,7 +2,7 @@
 #include <stdio.h>
 #include <string.h>
 
-bool SaveData::Save(int highScore, int audioVolume) {
+bool SaveData::Save(int highScore, int audioVolume, int theme) {
     // Try multiple writable locations
     const char* savePaths[] = {
         "/user/home/2048_save.dat",
@@ -16,6 +16,7 @@ bool SaveData::Save(int highScore, int audioVolume) {
     saveData.version = SAVE_VERSION;
     saveData.highScore = highScore;
     saveData.audioVolume = audioVolume;
+    saveData.theme = theme;
     memset(saveData.padding, 0, sizeof(saveData.padding));
     
     // Try each path until one works
@@ -36,7 +37,7 @@ bool SaveData::Save(int highScore, int audioVolume) {
     return false;
 }
 
-bool SaveData::Load(int& highScore, int& audioVolume) {
+bool SaveData::Load(int& highScore, int& audioVolume, int& theme) {
     // Try multiple possible save locations
     const char* savePaths[] = {
         "/user/home/2048_save.dat",
@@ -55,6 +56,7 @@ bool SaveData::Load(int& highScore, int& audioVolume) {
                 // Load data
                 highScore = saveData.highScore;
                 audioVolume = saveData.audioVolume;
+                theme = saveData.theme;
                 
                 printf("[INFO] Game data loaded successfully from %s\n", savePaths[i]);
                 printf("[INFO] High Score: %d, Volume: %d%%\n", highScore, audioVolume);
@@ -8,14 +8,15 @@ struct GameSaveData {
     uint32_t version;      // Save version
     int highScore;         // High score
     int audioVolume;       // Audio volume (0-100)
-    uint8_t padding[16];   // Reserved for future use
+    int theme;             // Theme index, zero (classic) in saves from before themes
+    uint8_t padding[12];   // Reserved for future use
 };
 
 // Save/Load system
 class SaveData {
 public:
-    static bool Save(int highScore, int audioVolume);
-    static bool Load(int& highScore, int& audioVolume);
+    static bool Save(int highScore, int audioVolume, int theme);
+    static bool Load(int& highScore, int& audioVolume, int& theme);
     
 private:
     SaveData() = delete;
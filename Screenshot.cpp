@@ -0,0 +1,184 @@
+#include "Screenshot.h"
+#include "ImageWriter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#ifndef SCENE2D_HEADLESS
+#include <orbis/libkernel.h>
+#endif
+
+// Tried in order until one is writable, USB first so captures are easy to get at
+static const char* const screenshotDirs[] = {
+    "/mnt/usb0/",
+    "/data/",
+    "/user/home/"
+};
+
+Screenshot::Screenshot() {
+    for (int i = 0; i < SCREENSHOT_POOL_SIZE; i++) {
+        buffers[i] = nullptr;
+        bufferQueued[i] = false;
+    }
+    
+    queueHead = 0;
+    queueCount = 0;
+    width = 0;
+    height = 0;
+    format = PIXEL_FORMAT_A8R8G8B8_SRGB;
+    sequence = 0;
+    started = false;
+    quitting = false;
+    
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&cond, nullptr);
+}
+
+Screenshot::~Screenshot() {
+    Shutdown();
+    
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+}
+
+bool Screenshot::Init(Scene2D* scene) {
+    Shutdown();
+    
+    width = scene->GetWidth();
+    height = scene->GetHeight();
+    format = scene->GetPixelFormat();
+    
+    // Touched up front so the first capture doesn't fault its pages in mid-frame
+    size_t size = (size_t)width * height * sizeof(uint32_t);
+    for (int i = 0; i < SCREENSHOT_POOL_SIZE; i++) {
+        if (posix_memalign((void**)&buffers[i], 64, size) != 0) {
+            buffers[i] = nullptr;
+            Shutdown();
+            return false;
+        }
+        memset(buffers[i], 0, size);
+    }
+    
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+#ifndef SCENE2D_HEADLESS
+    // Lowest priority, so encoding only ever runs in time the game threads leave idle
+    sched_param param;
+    param.sched_priority = ORBIS_KERNEL_PRIO_FIFO_LOWEST;
+    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    pthread_attr_setschedparam(&attr, &param);
+#endif
+
+    quitting = false;
+    int rc = pthread_create(&thread, &attr, writerThread, this);
+    pthread_attr_destroy(&attr);
+    
+    if (rc != 0) {
+        printf("[ERROR] Failed to create screenshot thread\n");
+        Shutdown();
+        return false;
+    }
+    
+    started = true;
+    return true;
+}
+
+void Screenshot::Shutdown() {
+    if (started) {
+        // Captures already taken are still written out
+        pthread_mutex_lock(&mutex);
+        quitting = true;
+        pthread_cond_signal(&cond);
+        pthread_mutex_unlock(&mutex);
+        
+        pthread_join(thread, nullptr);
+        started = false;
+    }
+    
+    for (int i = 0; i < SCREENSHOT_POOL_SIZE; i++) {
+        free(buffers[i]);
+        buffers[i] = nullptr;
+        bufferQueued[i] = false;
+    }
+    
+    queueHead = 0;
+    queueCount = 0;
+}
+
+bool Screenshot::Capture(Scene2D* scene) {
+    if (!started) return false;
+    
+    // Only this thread claims buffers, the writer just hands them back
+    int index = -1;
+    pthread_mutex_lock(&mutex);
+    for (int i = 0; i < SCREENSHOT_POOL_SIZE && index < 0; i++) {
+        if (!bufferQueued[i]) index = i;
+    }
+    pthread_mutex_unlock(&mutex);
+    
+    if (index < 0) {
+        printf("[WARN] Screenshot dropped, earlier captures are still being written\n");
+        return false;
+    }
+    
+    scene->CopyFrame(buffers[index], width);
+    
+    pthread_mutex_lock(&mutex);
+    bufferQueued[index] = true;
+    queue[(queueHead + queueCount) % SCREENSHOT_POOL_SIZE] = index;
+    queueCount++;
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+    return true;
+}
+
+void* Screenshot::writerThread(void* arg) {
+    Screenshot* shot = (Screenshot*)arg;
+    
+    pthread_mutex_lock(&shot->mutex);
+    for (;;) {
+        while (shot->queueCount == 0 && !shot->quitting) {
+            pthread_cond_wait(&shot->cond, &shot->mutex);
+        }
+        if (shot->queueCount == 0) break;
+        
+        int index = shot->queue[shot->queueHead];
+        shot->queueHead = (shot->queueHead + 1) % SCREENSHOT_POOL_SIZE;
+        shot->queueCount--;
+        pthread_mutex_unlock(&shot->mutex);
+        
+        shot->writeImage(shot->buffers[index]);
+        
+        pthread_mutex_lock(&shot->mutex);
+        shot->bufferQueued[index] = false;
+    }
+    pthread_mutex_unlock(&shot->mutex);
+    
+    return nullptr;
+}
+
+void Screenshot::writeImage(const uint32_t* pixels) {
+    time_t now = time(NULL);
+    struct tm local;
+    localtime_r(&now, &local);
+    
+    // The sequence number keeps captures taken within the same second apart
+    char name[64];
+    snprintf(name, sizeof(name), "2048_%04d%02d%02d_%02d%02d%02d_%u.png",
+             local.tm_year + 1900, local.tm_mon + 1, local.tm_mday,
+             local.tm_hour, local.tm_min, local.tm_sec, sequence++);
+    
+    char path[128];
+    for (size_t i = 0; i < sizeof(screenshotDirs) / sizeof(screenshotDirs[0]); i++) {
+        snprintf(path, sizeof(path), "%s%s", screenshotDirs[i], name);
+        
+        if (WritePNG(path, pixels, width, height, width, format)) {
+            printf("[INFO] Screenshot saved to %s\n", path);
+            return;
+        }
+    }
+    
+    printf("[ERROR] Failed to save screenshot %s to any location\n", name);
+}
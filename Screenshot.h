@@ -0,0 +1,45 @@
+#pragma once
+
+#include <pthread.h>
+#include <stdint.h>
+#include "graphics.h"
+
+// Staging buffers, so a capture can be taken while the previous one is still being written
+#define SCREENSHOT_POOL_SIZE 2
+
+// Captures frames into preallocated staging buffers on the render thread and leaves PNG
+// encoding and file I/O to a low-priority thread, so a capture costs one frame copy.
+class Screenshot {
+public:
+    Screenshot();
+    ~Screenshot();
+    
+    // Allocates staging buffers for frames of the scene's drawing size and starts the writer
+    bool Init(Scene2D* scene);
+    void Shutdown();
+    
+    // Copies the frame last queued on the scene, call between QueueFrame and FrameBufferSwap.
+    // Returns false and drops the capture while every staging buffer is still being written.
+    bool Capture(Scene2D* scene);
+
+private:
+    static void* writerThread(void* arg);
+    void writeImage(const uint32_t* pixels);
+    
+    uint32_t* buffers[SCREENSHOT_POOL_SIZE];
+    bool bufferQueued[SCREENSHOT_POOL_SIZE];
+    int queue[SCREENSHOT_POOL_SIZE];
+    int queueHead;
+    int queueCount;
+    
+    int width;
+    int height;
+    PixelFormat format;
+    unsigned int sequence;
+    
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool started;
+    bool quitting;
+};
@@ -0,0 +1,69 @@
+#include "TextLayout.h"
+#include <string.h>
+
+TextRun TextLayout::numberRuns[TEXT_RUN_CACHE_SIZE];
+
+// "00" .. "99", so each division yields two digits
+static const char digitPairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+int TextLayout::FormatInt(int value, char* buffer) {
+    char digits[TEXT_NUMBER_LENGTH];
+    char* p = digits + sizeof(digits);
+    
+    // Unsigned, so INT_MIN negates without overflowing
+    uint32_t n = value < 0 ? 0u - (uint32_t)value : (uint32_t)value;
+    
+    while (n >= 100) {
+        uint32_t pair = (n % 100) * 2;
+        n /= 100;
+        *--p = digitPairs[pair + 1];
+        *--p = digitPairs[pair];
+    }
+    
+    if (n >= 10) {
+        *--p = digitPairs[n * 2 + 1];
+        *--p = digitPairs[n * 2];
+    } else {
+        *--p = (char)('0' + n);
+    }
+    
+    if (value < 0) *--p = '-';
+    
+    int length = (int)(digits + sizeof(digits) - p);
+    memcpy(buffer, p, length);
+    buffer[length] = '\0';
+    return length;
+}
+
+int TextLayout::Measure(const BitmapFont* font, int length, int scale) {
+    if (length <= 0) return 0;
+    
+    return (length * font->advance - (font->advance - font->glyphWidth)) * scale;
+}
+
+int TextLayout::AlignX(int x, int width, TextAlign align) {
+    switch (align) {
+        case ALIGN_CENTER: return x - width / 2;
+        case ALIGN_RIGHT: return x - width;
+        default: return x;
+    }
+}
+
+const TextRun* TextLayout::Number(const BitmapFont* font, int value, int scale) {
+    uint32_t hash = ((uint32_t)value * 2654435761u) ^ ((uint32_t)scale * 40503u);
+    TextRun* run = &numberRuns[(hash >> 16) & (TEXT_RUN_CACHE_SIZE - 1)];
+    
+    if (run->font == font && run->scale == scale && run->value == value) return run;
+    
+    run->font = font;
+    run->scale = scale;
+    run->value = value;
+    run->length = FormatInt(value, run->text);
+    run->width = Measure(font, run->length, scale);
+    return run;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include "graphics.h"
+
+// Longest formatted int: sign, ten digits and a terminator
+#define TEXT_NUMBER_LENGTH 12
+
+// Number runs kept laid out, direct mapped by value and scale (power of two)
+#define TEXT_RUN_CACHE_SIZE 64
+
+// Horizontal anchoring of a run on its x coordinate
+enum TextAlign {
+    ALIGN_LEFT,
+    ALIGN_CENTER,
+    ALIGN_RIGHT
+};
+
+// A number formatted and measured for one font and scale
+struct TextRun {
+    const BitmapFont* font;     // Key: font, scale and value
+    int scale;
+    int value;
+    int length;
+    int width;                  // In pixels
+    char text[TEXT_NUMBER_LENGTH];
+};
+
+// Measuring and placing bitmap font text. The font has a fixed advance, so measuring a
+// string is a multiply; numbers are the only text that needs formatting, and their runs
+// are cached so unchanged scores and tiles cost no formatting at all.
+class TextLayout {
+public:
+    // Writes value's decimal digits and a terminator, returns the length
+    static int FormatInt(int value, char* buffer);
+    
+    // Width of length glyphs, without the spacing after the last one
+    static int Measure(const BitmapFont* font, int length, int scale);
+    
+    // Left edge of a run of the given width anchored at x
+    static int AlignX(int x, int width, TextAlign align);
+    
+    // The laid-out run for value, formatted only on a cache miss
+    static const TextRun* Number(const BitmapFont* font, int value, int scale);
+
+private:
+    TextLayout() = delete;
+    
+    static TextRun numberRuns[TEXT_RUN_CACHE_SIZE];
+};
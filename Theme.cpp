@@ -0,0 +1,185 @@
+#include "Theme.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+// Writable copies that override the packaged file, tried in order like the save data paths
+static const char* const themeOverridePaths[] = {
+    "/user/home/2048_themes.txt",
+    "/data/2048_themes.txt"
+};
+
+// Classic color definitions, indexed by PaletteColor
+static const Color classicColors[PAL_COUNT] = {
+    { 0xFA, 0xF8, 0xEF, 0xFF }, // Background
+    { 0x77, 0x6E, 0x65, 0xFF }, // Dark text
+    { 0xF9, 0xF6, 0xF2, 0xFF }, // Light text
+    { 0xF6, 0x7C, 0x5F, 0xFF }, // Menu highlight
+    { 0xFA, 0xF8, 0xEF, 0xD8 }, // Game over overlay, translucent background
+    { 0x00, 0x00, 0x00, 0xB0 }, // Profiler panel
+    { 0xED, 0xCF, 0x72, 0xFF }, // You win
+    { 0xF6, 0x7C, 0x5F, 0xFF }  // Game over
+};
+
+// Classic tiles up to 2048, higher tiles keep the 2048 color
+static const Color classicTiles[] = {
+    { 0xCD, 0xC1, 0xB4, 0xFF }, // Empty tile
+    { 0xEE, 0xE4, 0xDA, 0xFF }, // 2
+    { 0xED, 0xE0, 0xC8, 0xFF }, // 4
+    { 0xF2, 0xB1, 0x79, 0xFF }, // 8
+    { 0xF5, 0x95, 0x63, 0xFF }, // 16
+    { 0xF6, 0x7C, 0x5F, 0xFF }, // 32
+    { 0xF6, 0x5E, 0x3B, 0xFF }, // 64
+    { 0xED, 0xCF, 0x72, 0xFF }, // 128
+    { 0xED, 0xCC, 0x61, 0xFF }, // 256
+    { 0xED, 0xC8, 0x50, 0xFF }, // 512
+    { 0xED, 0xC5, 0x3F, 0xFF }, // 1024
+    { 0xED, 0xC2, 0x2E, 0xFF }  // 2048
+};
+
+// Key names in the theme file, indexed by PaletteColor
+static const char* const colorKeys[PAL_COUNT] = {
+    "background",
+    "dark_text",
+    "light_text",
+    "highlight",
+    "overlay",
+    "profiler_panel",
+    "win_text",
+    "lose_text"
+};
+
+void ThemeFile::GetClassic(Theme* theme) {
+    int tileCount = sizeof(classicTiles) / sizeof(classicTiles[0]);
+    
+    memset(theme, 0, sizeof(*theme));
+    strcpy(theme->name, "CLASSIC");
+    memcpy(theme->colors, classicColors, sizeof(classicColors));
+    
+    for (int i = 0; i < TILE_EXPONENT_COUNT; i++) {
+        theme->tileColors[i] = classicTiles[i < tileCount ? i : tileCount - 1];
+        
+        // Light numbers from 8 up
+        theme->tileTextColors[i] = classicColors[i >= 3 ? PAL_LIGHT_TEXT : PAL_DARK_TEXT];
+    }
+}
+
+bool ThemeFile::parseColor(const char* text, Color* color) {
+    char* end;
+    size_t length = strlen(text);
+    unsigned long value = strtoul(text, &end, 16);
+    
+    if (*end != '\0' || (length != 6 && length != 8)) return false;
+    
+    if (length == 6) {
+        value = (value << 8) | 0xFF;
+    }
+    
+    color->r = (uint8_t)(value >> 24);
+    color->g = (uint8_t)(value >> 16);
+    color->b = (uint8_t)(value >> 8);
+    color->a = (uint8_t)value;
+    return true;
+}
+
+void ThemeFile::extendTiles(Theme* theme, int lastTile, int lastText) {
+    for (int i = lastTile + 1; lastTile >= 0 && i < TILE_EXPONENT_COUNT; i++) {
+        theme->tileColors[i] = theme->tileColors[lastTile];
+    }
+    
+    for (int i = lastText + 1; lastText >= 0 && i < TILE_EXPONENT_COUNT; i++) {
+        theme->tileTextColors[i] = theme->tileTextColors[lastText];
+    }
+}
+
+int ThemeFile::Load(const char* path, Theme* themes, int maxThemes) {
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        printf("[INFO] No theme file at %s\n", path);
+        return 0;
+    }
+    
+    char line[128];
+    int count = 0;
+    int lineNumber = 0;
+    int lastTile = -1;
+    int lastText = -1;
+    Theme* theme = NULL;
+    
+    while (fgets(line, sizeof(line), file)) {
+        lineNumber++;
+        
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        
+        // Tokens are cut at 31 characters, so a theme name always fits THEME_NAME_LENGTH
+        char key[32];
+        char arg[THEME_NAME_LENGTH];
+        char value[32];
+        int fields = sscanf(line, "%31s %31s %31s", key, arg, value);
+        if (fields <= 0) continue;
+        
+        if (strcmp(key, "theme") == 0 && fields >= 2) {
+            if (theme) extendTiles(theme, lastTile, lastText);
+            
+            if (count == maxThemes) {
+                printf("[WARN] %s: more than %d themes, ignoring the rest\n", path, maxThemes);
+                theme = NULL;
+                break;
+            }
+            
+            theme = &themes[count++];
+            GetClassic(theme);
+            snprintf(theme->name, sizeof(theme->name), "%s", arg);
+            lastTile = -1;
+            lastText = -1;
+            continue;
+        }
+        
+        bool valid = false;
+        
+        if (theme && (strcmp(key, "tile") == 0 || strcmp(key, "text") == 0) && fields == 3) {
+            int exponent = atoi(arg);
+            bool isTile = (key[1] == 'i');
+            
+            if (exponent >= 0 && exponent < TILE_EXPONENT_COUNT) {
+                valid = parseColor(value, isTile ? &theme->tileColors[exponent] : &theme->tileTextColors[exponent]);
+                
+                int& last = isTile ? lastTile : lastText;
+                if (valid && exponent > last) last = exponent;
+            }
+        } else if (theme && fields == 2) {
+            for (int i = 0; i < PAL_COUNT; i++) {
+                if (strcmp(key, colorKeys[i]) == 0) {
+                    valid = parseColor(arg, &theme->colors[i]);
+                    break;
+                }
+            }
+        }
+        
+        if (!valid) {
+            printf("[WARN] %s:%d: ignoring '%s'\n", path, lineNumber, key);
+        }
+    }
+    
+    if (theme) extendTiles(theme, lastTile, lastText);
+    
+    fclose(file);
+    return count;
+}
+
+int64_t ThemeFile::GetModifiedTime(const char* path) {
+    struct stat info;
+    if (stat(path, &info) != 0) return 0;
+    
+    return (int64_t)info.st_mtime;
+}
+
+const char* ThemeFile::FindPath() {
+    for (size_t i = 0; i < sizeof(themeOverridePaths) / sizeof(themeOverridePaths[0]); i++) {
+        if (GetModifiedTime(themeOverridePaths[i]) != 0) return themeOverridePaths[i];
+    }
+    
+    return THEME_FILE_PATH;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <stdint.h>
+#include "graphics.h"
+
+// Themes shipped with the game, reloaded whenever the file changes on disk. /app0 is
+// read-only, so a copy in one of the writable override paths takes precedence.
+#ifndef THEME_FILE_PATH
+#define THEME_FILE_PATH "/app0/assets/misc/themes.txt"
+#endif
+#define THEME_MAX_COUNT 8
+#define THEME_NAME_LENGTH 32     // Holds a whole token from the file, see ThemeFile::Load
+
+// Tile colors are indexed by exponent: the empty tile, then 2^1 .. 2^17
+#define TILE_EXPONENT_COUNT 18
+
+// Screen color slots, the tile colors live in their own exponent-indexed tables
+enum PaletteColor {
+    PAL_BACKGROUND,
+    PAL_DARK_TEXT,
+    PAL_LIGHT_TEXT,
+    PAL_MENU_HIGHLIGHT,
+    PAL_OVERLAY,
+    PAL_PROFILER_PANEL,
+    PAL_WIN_TEXT,
+    PAL_LOSE_TEXT,
+    PAL_COUNT
+};
+
+struct Theme {
+    char name[THEME_NAME_LENGTH];
+    Color colors[PAL_COUNT];
+    Color tileColors[TILE_EXPONENT_COUNT];
+    Color tileTextColors[TILE_EXPONENT_COUNT];
+};
+
+// Theme file loading. The file is plain text, one setting per line:
+//
+//     theme DARK
+//     background 1E1E24
+//     tile 3 F2B179
+//     text 3 F9F6F2
+//
+// Colors are RRGGBB or RRGGBBAA. Each theme starts as a copy of the classic one, and
+// exponents past the last listed tile reuse its colors.
+class ThemeFile {
+public:
+    static void GetClassic(Theme* theme);
+    
+    // Returns the number of themes read, 0 when the file is missing or holds none
+    static int Load(const char* path, Theme* themes, int maxThemes);
+    
+    // Modification time of the file, 0 if it doesn't exist
+    static int64_t GetModifiedTime(const char* path);
+    
+    // The first writable override that exists, else THEME_FILE_PATH. The returned
+    // pointer is the same for the same file, so callers can compare it to spot a switch.
+    static const char* FindPath();
+
+private:
+    ThemeFile() = delete;
+    
+    static bool parseColor(const char* text, Color* color);
+    static void extendTiles(Theme* theme, int lastTile, int lastText);
+};
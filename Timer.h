@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef SCENE2D_HEADLESS
+#include <time.h>
+#include <unistd.h>
+
+// Monotonic time in microseconds
+static inline uint64_t GetTimeUsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline void SleepUsec(unsigned int usec) {
+    usleep(usec);
+}
+#else
+#include <orbis/libkernel.h>
+
+// Monotonic process time in microseconds
+static inline uint64_t GetTimeUsec() {
+    return sceKernelGetProcessTime();
+}
+
+static inline void SleepUsec(unsigned int usec) {
+    sceKernelUsleep(usec);
+}
+#endif
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <atomic>
+
+// Lock-free single producer / single consumer handoff of whole values.
+// The writer fills WriteBuffer() and publishes it; the reader picks up the
+// newest published value without ever blocking or seeing a partial write.
+template <class T>
+class TripleBuffer {
+public:
+    TripleBuffer() : back(0), middle(1), front(2) {}
+    
+    T& WriteBuffer() {
+        return slots[back];
+    }
+    
+    void Publish() {
+        back = middle.exchange(back | FRESH_BIT) & INDEX_MASK;
+    }
+    
+    // Returns true when a newer value than the current ReadBuffer() was picked up
+    bool Acquire() {
+        if (!(middle.load() & FRESH_BIT)) return false;
+        front = middle.exchange(front) & INDEX_MASK;
+        return true;
+    }
+    
+    const T& ReadBuffer() const {
+        return slots[front];
+    }
+    
+private:
+    static const int INDEX_MASK = 3;
+    static const int FRESH_BIT = 4;
+    
+    T slots[3];
+    int back;
+    std::atomic<int> middle;
+    int front;
+};
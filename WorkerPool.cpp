@@ -0,0 +1,135 @@
+#include "WorkerPool.h"
+#include <stdio.h>
+
+WorkerPool::WorkerPool() {
+    threads = nullptr;
+    numWorkers = 0;
+    
+    currentJob = nullptr;
+    currentArg = nullptr;
+    currentJobCount = 0;
+    nextJob = 0;
+    
+    busyWorkers = 0;
+    generation = 0;
+    quitting = false;
+    
+    pthread_mutex_init(&mutex, nullptr);
+    pthread_cond_init(&startCond, nullptr);
+    pthread_cond_init(&doneCond, nullptr);
+}
+
+WorkerPool::~WorkerPool() {
+    Shutdown();
+    
+    pthread_cond_destroy(&doneCond);
+    pthread_cond_destroy(&startCond);
+    pthread_mutex_destroy(&mutex);
+}
+
+bool WorkerPool::Init(int numThreads) {
+    Shutdown();
+    
+    if (numThreads < 1) numThreads = 1;
+    
+    // New workers start having seen generation 0, so a count left over from an earlier pool
+    // would wake them on a Run that already finished
+    quitting = false;
+    generation = 0;
+    threads = new pthread_t[numThreads - 1];
+    
+    for (int i = 0; i < numThreads - 1; i++) {
+        if (pthread_create(&threads[i], nullptr, workerThread, this) != 0) {
+            printf("[ERROR] Failed to create worker thread %d\n", i);
+            Shutdown();
+            return false;
+        }
+        numWorkers++;
+    }
+    
+    return true;
+}
+
+void WorkerPool::Shutdown() {
+    if (!threads) return;
+    
+    pthread_mutex_lock(&mutex);
+    quitting = true;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&mutex);
+    
+    for (int i = 0; i < numWorkers; i++) {
+        pthread_join(threads[i], nullptr);
+    }
+    
+    delete[] threads;
+    threads = nullptr;
+    numWorkers = 0;
+}
+
+int WorkerPool::GetThreadCount() {
+    return numWorkers + 1;
+}
+
+void WorkerPool::runJobs() {
+    // Jobs are handed out one index at a time so uneven jobs still balance
+    for (;;) {
+        int index = nextJob.fetch_add(1);
+        if (index >= currentJobCount) break;
+        currentJob(currentArg, index);
+    }
+}
+
+void WorkerPool::Run(WorkerJob job, void* arg, int jobCount) {
+    if (numWorkers == 0) {
+        for (int i = 0; i < jobCount; i++) {
+            job(arg, i);
+        }
+        return;
+    }
+    
+    pthread_mutex_lock(&mutex);
+    currentJob = job;
+    currentArg = arg;
+    currentJobCount = jobCount;
+    nextJob = 0;
+    busyWorkers = numWorkers;
+    generation++;
+    pthread_cond_broadcast(&startCond);
+    pthread_mutex_unlock(&mutex);
+    
+    // The calling thread takes its share instead of idling
+    runJobs();
+    
+    pthread_mutex_lock(&mutex);
+    while (busyWorkers > 0) {
+        pthread_cond_wait(&doneCond, &mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void* WorkerPool::workerThread(void* arg) {
+    WorkerPool* pool = (WorkerPool*)arg;
+    unsigned int seenGeneration = 0;
+    
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (!pool->quitting && pool->generation == seenGeneration) {
+            pthread_cond_wait(&pool->startCond, &pool->mutex);
+        }
+        
+        if (pool->quitting) break;
+        seenGeneration = pool->generation;
+        pthread_mutex_unlock(&pool->mutex);
+        
+        pool->runJobs();
+        
+        pthread_mutex_lock(&pool->mutex);
+        if (--pool->busyWorkers == 0) {
+            pthread_cond_signal(&pool->doneCond);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    
+    return nullptr;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <pthread.h>
+#include <atomic>
+
+// Job callback, invoked once for every index in [0, jobCount)
+typedef void (*WorkerJob)(void* arg, int jobIndex);
+
+// Fixed pool of worker threads that split indexed jobs with the calling thread
+class WorkerPool {
+public:
+    WorkerPool();
+    ~WorkerPool();
+    
+    // numThreads counts the calling thread, so 1 means no workers are spawned
+    bool Init(int numThreads);
+    void Shutdown();
+    
+    // Runs every job and returns once all of them have completed
+    void Run(WorkerJob job, void* arg, int jobCount);
+    int GetThreadCount();
+    
+private:
+    static void* workerThread(void* arg);
+    void runJobs();
+    
+    pthread_t* threads;
+    int numWorkers;
+    
+    pthread_mutex_t mutex;
+    pthread_cond_t startCond;
+    pthread_cond_t doneCond;
+    
+    WorkerJob currentJob;
+    void* currentArg;
+    int currentJobCount;
+    std::atomic<int> nextJob;
+    
+    int busyWorkers;
+    unsigned int generation;
+    bool quitting;
+};
@@ -11,6 +11,7 @@ Rem Libraries to link in
 set libraries=-lc -lkernel -lc++ -lScePad -lSceUserService -lSceVideoOut -lSceAudioOut -lSceSysmodule -lSceSaveData -lpthread
 
 Rem set extra_flags=
+Rem FreeType text in Scene2D: set extra_flags=-DGRAPHICS_USES_FONT and add -lSceFreeTypeOl to the libraries
 
 Rem Read the script arguments into local vars
 set intdir=%1
@@ -1,4 +1,5 @@
 #include "controller.h"
+#include <string.h>
 
 Controller::Controller()
 {
@@ -6,6 +7,7 @@ Controller::Controller()
     this->pad = -1;
     this->buttonState = 0;
     this->prevButtonState = 0;
+    resetPadData();
 }
 
 Controller::~Controller()
@@ -48,131 +50,122 @@ bool Controller::Init(int controllerUserID)
     return true;
 }
 
-void Controller::setButtonState(int state)
+bool Controller::Update()
 {
+	int rc = scePadReadState(this->pad, &this->padData);
+	
+	// A failed read or a disconnected pad reads as nothing held and centred sticks
+	if (rc != 0 || !this->padData.connected)
+		resetPadData();
+	
 	this->prevButtonState = this->buttonState;
-	this->buttonState = state;
-}
-
-bool Controller::CheckButtonsPressed(int stateToCheck)
-{
-	scePadReadState(this->pad, &this->padData);
-	setButtonState(this->padData.buttons);
-        
-	if (stateToCheck & ORBIS_PAD_BUTTON_TRIANGLE && !(this->buttonState & ORBIS_PAD_BUTTON_TRIANGLE))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_CIRCLE && !(this->buttonState & ORBIS_PAD_BUTTON_CIRCLE))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_CROSS && !(this->buttonState & ORBIS_PAD_BUTTON_CROSS))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_SQUARE && !(this->buttonState & ORBIS_PAD_BUTTON_SQUARE))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_L1 && !(this->buttonState & ORBIS_PAD_BUTTON_L1))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_R1 && !(this->buttonState & ORBIS_PAD_BUTTON_R1))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_L2 && !(this->buttonState & ORBIS_PAD_BUTTON_L2))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_R2 && !(this->buttonState & ORBIS_PAD_BUTTON_R2))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_L3 && !(this->buttonState & ORBIS_PAD_BUTTON_L3))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_R3 && !(this->buttonState & ORBIS_PAD_BUTTON_R3))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_OPTIONS && !(this->buttonState & ORBIS_PAD_BUTTON_OPTIONS))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_UP && !(this->buttonState & ORBIS_PAD_BUTTON_UP))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_RIGHT && !(this->buttonState & ORBIS_PAD_BUTTON_RIGHT))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_DOWN && !(this->buttonState & ORBIS_PAD_BUTTON_DOWN))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_LEFT && !(this->buttonState & ORBIS_PAD_BUTTON_LEFT))
-		return false;
-	if (stateToCheck & ORBIS_PAD_BUTTON_TOUCH_PAD && !(this->buttonState & ORBIS_PAD_BUTTON_TOUCH_PAD))
-		return false;
-
-	return true;
+	this->buttonState = this->padData.buttons;
+	
+	return rc == 0;
+}
+
+void Controller::resetPadData()
+{
+	memset(&this->padData, 0, sizeof(this->padData));
+	this->padData.leftStick.x = 128;
+	this->padData.leftStick.y = 128;
+	this->padData.rightStick.x = 128;
+	this->padData.rightStick.y = 128;
+}
+
+bool Controller::IsHeld(int buttons)
+{
+	return (this->buttonState & buttons) == buttons;
+}
+
+bool Controller::WasPressed(int buttons)
+{
+	return (this->buttonState & ~this->prevButtonState & buttons) != 0;
+}
+
+bool Controller::WasReleased(int buttons)
+{
+	return (~this->buttonState & this->prevButtonState & buttons) != 0;
 }
 
 bool Controller::TrianglePressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_TRIANGLE);
+	return IsHeld(ORBIS_PAD_BUTTON_TRIANGLE);
 }
 
 bool Controller::CirclePressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_CIRCLE);
+	return IsHeld(ORBIS_PAD_BUTTON_CIRCLE);
 }
 
 bool Controller::XPressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_CROSS);
+	return IsHeld(ORBIS_PAD_BUTTON_CROSS);
 }
 
 bool Controller::SquarePressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_SQUARE);
+	return IsHeld(ORBIS_PAD_BUTTON_SQUARE);
 }
 
 bool Controller::L1Pressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_L1);
+	return IsHeld(ORBIS_PAD_BUTTON_L1);
 }
 
 bool Controller::L2Pressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_L2);
+	return IsHeld(ORBIS_PAD_BUTTON_L2);
 }
 
 bool Controller::R1Pressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_R1);
+	return IsHeld(ORBIS_PAD_BUTTON_R1);
 }
 
 bool Controller::R2Pressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_R2);
+	return IsHeld(ORBIS_PAD_BUTTON_R2);
 }
 
 bool Controller::L3Pressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_L3);
+	return IsHeld(ORBIS_PAD_BUTTON_L3);
 }
 
 bool Controller::R3Pressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_R3);
+	return IsHeld(ORBIS_PAD_BUTTON_R3);
 }
 
 bool Controller::StartPressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_OPTIONS);
+	return IsHeld(ORBIS_PAD_BUTTON_OPTIONS);
 }
 
 bool Controller::DpadUpPressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_UP);
+	return IsHeld(ORBIS_PAD_BUTTON_UP);
 }
 
 bool Controller::DpadRightPressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_RIGHT);
+	return IsHeld(ORBIS_PAD_BUTTON_RIGHT);
 }
 
 bool Controller::DpadDownPressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_DOWN);
+	return IsHeld(ORBIS_PAD_BUTTON_DOWN);
 }
 
 bool Controller::DpadLeftPressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_LEFT);
+	return IsHeld(ORBIS_PAD_BUTTON_LEFT);
 }
 
 bool Controller::TouchpadPressed()
 {
-	return CheckButtonsPressed(ORBIS_PAD_BUTTON_TOUCH_PAD);
+	return IsHeld(ORBIS_PAD_BUTTON_TOUCH_PAD);
 }
 
 // Normalize analog stick value from 0-255 to -1.0 to 1.0
@@ -182,27 +175,44 @@ float Controller::normalizeStickValue(uint8_t value)
     return (value - 128) / 128.0f;
 }
 
+bool Controller::HasInput(float stickThreshold)
+{
+    if (this->padData.buttons != 0)
+        return true;
+    
+    float sticks[4] = {
+        normalizeStickValue(this->padData.leftStick.x),
+        normalizeStickValue(this->padData.leftStick.y),
+        normalizeStickValue(this->padData.rightStick.x),
+        normalizeStickValue(this->padData.rightStick.y)
+    };
+    
+    for (int i = 0; i < 4; i++)
+    {
+        if (sticks[i] > stickThreshold || sticks[i] < -stickThreshold)
+            return true;
+    }
+    
+    return false;
+}
+
 float Controller::GetLeftStickX()
 {
-    scePadReadState(this->pad, &this->padData);
     return normalizeStickValue(this->padData.leftStick.x);
 }
 
 float Controller::GetLeftStickY()
 {
-    scePadReadState(this->pad, &this->padData);
     return normalizeStickValue(this->padData.leftStick.y);
 }
 
 float Controller::GetRightStickX()
 {
-    scePadReadState(this->pad, &this->padData);
     return normalizeStickValue(this->padData.rightStick.x);
 }
 
 float Controller::GetRightStickY()
 {
-    scePadReadState(this->pad, &this->padData);
     return normalizeStickValue(this->padData.rightStick.y);
 }
 
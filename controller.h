@@ -11,8 +11,17 @@ public:
     
     bool Init(int controllerUserID);
     
-    bool CheckButtonsPressed(int stateToCheck);
+    // Reads the pad once. Every query below answers from this snapshot, so call it once per
+    // tick before any of them. Returns false if the read failed, which reads as no input.
+    bool Update();
     
+    // ORBIS_PAD_BUTTON_* masks. IsHeld needs every button in the mask down, WasPressed and
+    // WasReleased any of them going down or up since the previous Update.
+    bool IsHeld(int buttons);
+    bool WasPressed(int buttons);
+    bool WasReleased(int buttons);
+    
+    // Held state of single buttons
     bool TrianglePressed();
     bool CirclePressed();
     bool XPressed();
@@ -30,6 +39,9 @@ public:
     bool DpadLeftPressed();
     bool TouchpadPressed();
     
+    // Any button held or a stick pushed past the given deflection (0..1)
+    bool HasInput(float stickThreshold);
+    
     // Analog stick methods
     float GetLeftStickX();
     float GetLeftStickY();
@@ -42,7 +54,7 @@ public:
     bool IsTouchpadTouched();
     
 private:
-    void setButtonState(int state);
+    void resetPadData();
     float normalizeStickValue(uint8_t value);
     
     int userID;
@@ -6,17 +6,157 @@
 #include <string>
 
 #include "graphics.h"
+#include "WorkerPool.h"
+#include "DisplayList.h"
+#include "Timer.h"
 #include "log.h"
 
-Scene2D::Scene2D(int w, int h, int pixelDepth)
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#ifdef GRAPHICS_USES_FONT
+#include "GlyphCache.h"
+#endif
+
+// Pixel encoders, one per supported frame buffer format. Channels are premultiplied by alpha,
+// which leaves opaque colors untouched and makes translucent ones ready for source-over blending
+static inline uint32_t premultiply(uint8_t channel, uint8_t alpha)
+{
+	uint32_t x = channel * alpha + 128;
+	return (x + (x >> 8)) >> 8;
+}
+
+static Pixel encodeA8R8G8B8(Color color)
+{
+	return ((uint32_t)color.a << 24) | (premultiply(color.r, color.a) << 16) | (premultiply(color.g, color.a) << 8) | premultiply(color.b, color.a);
+}
+
+static Pixel encodeA8B8G8R8(Color color)
+{
+	return ((uint32_t)color.a << 24) | (premultiply(color.b, color.a) << 16) | (premultiply(color.g, color.a) << 8) | premultiply(color.r, color.a);
+}
+
+Scene2D::Scene2D(int w, int h, int pixelDepth, PixelFormat format)
 {
 	this->width = w;
 	this->height = h;
 	this->depth = pixelDepth;
 	
 	this->frameBufferSize = this->width * this->height * this->depth;
+	
+	// Pick the encoder matching the format the buffers will be registered with
+	this->pixelFormat = format;
+	this->pixelEncoder = (format == PIXEL_FORMAT_A8B8G8R8_SRGB) ? encodeA8B8G8R8 : encodeA8R8G8B8;
+	
+	this->video = 0;
+	this->activeFrameBufferIdx = 0;
+	this->numFrameBuffers = 0;
+	this->lastFlipArg = -1;
+	this->flipStallCount = 0;
+	
+	this->targetFrameRate = SCENE2D_DEFAULT_FRAME_RATE;
+	this->frameIntervalUsec = 1000000 / SCENE2D_DEFAULT_FRAME_RATE;
+	this->lastFlipCount = 0;
+	this->lastFlipTime = 0;
+	this->smoothedFrameUsec = this->frameIntervalUsec;
+	this->missedVsyncCount = 0;
+	this->skipPending = false;
+	this->resumeFrameID = -1;
+	this->lastMeasuredFrameID = -1;
+	this->threadedPresent = false;
+	
+	pthread_mutex_init(&this->flipMutex, NULL);
+	pthread_cond_init(&this->flipCond, NULL);
+	
+	for(int i = 0; i < SCENE2D_MAX_FRAME_BUFFERS; i++)
+		this->bufferFrameIDs[i] = -1;
+	
+	this->displayList = new DisplayList(SCENE2D_DISPLAY_LIST_SIZE);
+	this->rasterPool = NULL;
+	
+	this->numBands = (this->height + SCENE2D_BAND_HEIGHT - 1) / SCENE2D_BAND_HEIGHT;
+	this->bandSkipped = new uint8_t[this->numBands];
+	this->diffBands = true;
+	this->skippedBandCount = 0;
+	this->renderTarget = NULL;
+	this->flushHashes = NULL;
+	this->clipDepth = 0;
+	
+	this->surfaceMem = NULL;
+	this->surfaceMemSize = 0;
+	this->surfaceMemUsed = 0;
+	this->nextContentID = 1;
+	
+	this->backBuffer = NULL;
+	this->backHashes = new uint64_t[this->numBands];
+	this->renderScale = 1;
+	this->renderWidth = w;
+	this->renderHeight = h;
+	this->nextStaleHash = 1;
+	this->resolvedBandCount = 0;
+	this->resolveUsec = 0;
+	
+	this->frameBuffers = NULL;
+	
+	for(int i = 0; i < SCENE2D_MAX_FRAME_BUFFERS; i++)
+		this->bandHashes[i] = NULL;
+	
+	for(int i = 0; i <= SCENE2D_MAX_CORNER_RADIUS; i++)
+		this->cornerMasks[i] = NULL;
+	
+	applyClip();
+	
+#ifdef GRAPHICS_USES_FONT
+	this->ftLib = NULL;
+	this->glyphCache = new GlyphCache();
+	this->flushEpoch = 1;
+#endif
+}
+
+Scene2D::~Scene2D()
+{
+	delete this->rasterPool;
+	delete this->displayList;
+	delete[] this->bandSkipped;
+	delete[] this->backHashes;
+	free(this->backBuffer);
+	deallocateSurfaceMem();
+	
+	// Display memory may still be scanned out on the console, so only the headless
+	// mapping is released with the scene
+#ifdef SCENE2D_HEADLESS
+	deallocateVideoMem();
+#else
+	delete[] this->frameBuffers;
+#endif
+	
+	for(int i = 0; i < SCENE2D_MAX_FRAME_BUFFERS; i++)
+		delete[] this->bandHashes[i];
+	
+	for(int i = 0; i <= SCENE2D_MAX_CORNER_RADIUS; i++)
+		delete[] this->cornerMasks[i];
+	
+#ifdef GRAPHICS_USES_FONT
+	delete this->glyphCache;
+	
+	if(this->ftLib)
+		FT_Done_FreeType(this->ftLib);
+#endif
+	
+	pthread_cond_destroy(&this->flipCond);
+	pthread_mutex_destroy(&this->flipMutex);
+}
+
+bool Scene2D::SetRasterThreads(int numThreads)
+{
+	if(this->rasterPool == NULL)
+		this->rasterPool = new WorkerPool();
+	
+	return this->rasterPool->Init(numThreads);
 }
 
+#ifndef SCENE2D_HEADLESS
 bool Scene2D::Init(size_t memSize, int numFrameBuffers)
 {
 	int rc;
@@ -68,7 +208,7 @@ bool Scene2D::Init(size_t memSize, int numFrameBuffers)
 		return false;
 	}
 	
-	sceVideoOutSetFlipRate(this->video, 0);
+	setFlipRate(this->targetFrameRate);
 	return true;
 }
 
@@ -83,29 +223,13 @@ bool Scene2D::initFlipQueue()
 	return true;
 }
 
-bool Scene2D::allocateFrameBuffers(int num)
+bool Scene2D::registerFrameBuffers()
 {
-	// Allocate frame buffers array
-	this->frameBuffers = new char*[num];
-	
-	// Set the display buffers
-	for(int i = 0; i < num; i++)
-		this->frameBuffers[i] = this->allocateDisplayMem(frameBufferSize);
-
 	// Set SRGB pixel format
-	sceVideoOutSetBufferAttribute(&this->attr, 0x80000000, 1, 0, this->width, this->height, this->width);
+	sceVideoOutSetBufferAttribute(&this->attr, this->pixelFormat, 1, 0, this->width, this->height, this->width);
 	
 	// Register the buffers to the video handle
-	return (sceVideoOutRegisterBuffers(this->video, 0, (void **)this->frameBuffers, num, &this->attr) == 0);
-}
-
-char *Scene2D::allocateDisplayMem(size_t size)
-{
-	// Essentially just bump allocation
-	char *allocatedPtr = (char *)videoMemSP;
-	videoMemSP += size;
-
-	return allocatedPtr;
+	return (sceVideoOutRegisterBuffers(this->video, 0, (void **)this->frameBuffers, this->numFrameBuffers, &this->attr) == 0);
 }
 
 bool Scene2D::allocateVideoMem(size_t size, int alignment)
@@ -153,9 +277,120 @@ void Scene2D::deallocateVideoMem()
 	this->directMemOff = 0;
 	this->directMemAllocationSize = 0;
 	
-	// Free the frame buffer array
-	delete this->frameBuffers;
+	// Free the frame buffer array, no buffer carries a frame any more
+	delete[] this->frameBuffers;
 	this->frameBuffers = 0;
+	
+	for(int i = 0; i < SCENE2D_MAX_FRAME_BUFFERS; i++)
+		this->bufferFrameIDs[i] = -1;
+}
+
+bool Scene2D::allocateSurfaceMem(size_t size)
+{
+	int rc;
+	
+	// Write-back onion memory (type 0), unlike the write-combined frame buffers it is cached
+	// for CPU reads, which blits and blends do constantly
+	rc = sceKernelAllocateDirectMemory(0, sceKernelGetDirectMemorySize(), size, 0x200000, 0, &this->surfaceMemOff);
+	
+	if(rc < 0)
+		return false;
+	
+	rc = sceKernelMapDirectMemory((void **)&this->surfaceMem, size, 0x33, 0, this->surfaceMemOff, 0x200000);
+	
+	if(rc < 0)
+	{
+		sceKernelReleaseDirectMemory(this->surfaceMemOff, size);
+		this->surfaceMem = NULL;
+		return false;
+	}
+	
+	this->surfaceMemSize = size;
+	return true;
+}
+
+void Scene2D::deallocateSurfaceMem()
+{
+	if(this->surfaceMem == NULL)
+		return;
+	
+	sceKernelReleaseDirectMemory(this->surfaceMemOff, this->surfaceMemSize);
+	this->surfaceMem = NULL;
+	this->surfaceMemSize = 0;
+	this->surfaceMemUsed = 0;
+}
+#endif
+
+bool Scene2D::InitSurfaceArena(size_t size)
+{
+	if(this->surfaceMem != NULL)
+		return false;
+	
+	size = (size + 0x200000 - 1) / 0x200000 * 0x200000;
+	
+	if(!allocateSurfaceMem(size))
+	{
+		DEBUGLOG << "Failed to allocate surface memory: " << std::string(strerror(errno));
+		return false;
+	}
+	
+	this->surfaceMemUsed = 0;
+	return true;
+}
+
+bool Scene2D::CreateSurface(Surface *surface, int w, int h)
+{
+	if(w <= 0 || h <= 0)
+		return false;
+	
+	// Pad rows to whole 64-byte lines so every row starts aligned
+	int pitch = (w + SCENE2D_SURFACE_ALIGN / 4 - 1) & ~(SCENE2D_SURFACE_ALIGN / 4 - 1);
+	size_t size = (size_t)pitch * h * sizeof(uint32_t);
+	
+	if(this->surfaceMem == NULL || this->surfaceMemUsed + size > this->surfaceMemSize)
+		return false;
+	
+	surface->width = w;
+	surface->height = h;
+	surface->pitch = pitch;
+	surface->pixels = (uint32_t *)(this->surfaceMem + this->surfaceMemUsed);
+	surface->contentID = this->nextContentID++;
+	
+	this->surfaceMemUsed += size;
+	return true;
+}
+
+bool Scene2D::allocateFrameBuffers(int num)
+{
+	if(num < SCENE2D_MIN_FRAME_BUFFERS || num > SCENE2D_MAX_FRAME_BUFFERS)
+	{
+		DEBUGLOG << "Unsupported frame buffer count: " << num;
+		return false;
+	}
+	
+	this->numFrameBuffers = num;
+	
+	// Allocate frame buffers array
+	this->frameBuffers = new char*[num];
+	
+	// Set the display buffers, nothing has been drawn to them yet so no band can be skipped
+	for(int i = 0; i < num; i++)
+	{
+		this->frameBuffers[i] = this->allocateDisplayMem(frameBufferSize);
+		this->bandHashes[i] = new uint64_t[this->numBands];
+		memset(this->bandHashes[i], 0, this->numBands * sizeof(uint64_t));
+	}
+
+	return registerFrameBuffers();
+}
+
+char *Scene2D::allocateDisplayMem(size_t size)
+{
+	// Essentially just bump allocation
+	char *allocatedPtr = (char *)videoMemSP;
+	videoMemSP += size;
+
+	return allocatedPtr;
 }
 
 void Scene2D::SetActiveFrameBuffer(int index)
@@ -163,9 +398,39 @@ void Scene2D::SetActiveFrameBuffer(int index)
 	this->activeFrameBufferIdx = index;
 }
 
+void Scene2D::SetThreadedPresent(bool enabled)
+{
+	this->threadedPresent = enabled;
+}
+
+int Scene2D::QueueFrame(int frameID)
+{
+	if(this->backBuffer != NULL)
+		resolveBackBuffer();
+	
+	// Remember which frame this buffer carries so we know when it comes off screen
+	pthread_mutex_lock(&this->flipMutex);
+	this->bufferFrameIDs[this->activeFrameBufferIdx] = frameID;
+	
+	if(this->skipPending)
+	{
+		this->resumeFrameID = frameID;
+		this->skipPending = false;
+	}
+	pthread_mutex_unlock(&this->flipMutex);
+	
+	return this->activeFrameBufferIdx;
+}
+
 void Scene2D::SubmitFlip(int frameID)
 {
-	sceVideoOutSubmitFlip(this->video, this->activeFrameBufferIdx, ORBIS_VIDEO_OUT_FLIP_VSYNC, frameID);
+	SubmitFlip(QueueFrame(frameID), frameID);
+}
+
+#ifndef SCENE2D_HEADLESS
+void Scene2D::SubmitFlip(int bufferIndex, int frameID)
+{
+	sceVideoOutSubmitFlip(this->video, bufferIndex, ORBIS_VIDEO_OUT_FLIP_VSYNC, frameID);
 }
 
 void Scene2D::FrameWait(int frameID)
@@ -184,7 +449,14 @@ void Scene2D::FrameWait(int frameID)
 		// Get the flip status and check the arg for the given frame ID
 		sceVideoOutGetFlipStatus(video, &flipStatus);
 		
-		if(flipStatus.flipArg == frameID)
+		// Wake a render thread waiting for a buffer to come off screen
+		pthread_mutex_lock(&this->flipMutex);
+		this->lastFlipArg = flipStatus.flipArg;
+		recordFlip(flipStatus.count, flipStatus.processTime, flipStatus.flipArg);
+		pthread_cond_broadcast(&this->flipCond);
+		pthread_mutex_unlock(&this->flipMutex);
+		
+		if(flipStatus.flipArg >= frameID)
 			break;
 			
 		// Wait on next flip event
@@ -193,139 +465,910 @@ void Scene2D::FrameWait(int frameID)
 	}
 }
 
+void Scene2D::updateFlipStatus()
+{
+	OrbisVideoOutFlipStatus flipStatus;
+	
+	sceVideoOutGetFlipStatus(this->video, &flipStatus);
+	this->lastFlipArg = flipStatus.flipArg;
+	recordFlip(flipStatus.count, flipStatus.processTime, flipStatus.flipArg);
+}
+
+bool Scene2D::setFlipRate(int hz)
+{
+	// Flip rate 0, 1 and 2 show each frame for 1, 2 and 3 vblanks of the 60 Hz output
+	int rate;
+	
+	switch(hz)
+	{
+		case 60: rate = 0; break;
+		case 30: rate = 1; break;
+		case 20: rate = 2; break;
+		default: return false;
+	}
+	
+	return sceVideoOutSetFlipRate(this->video, rate) == 0;
+}
+
+bool Scene2D::waitFlipEvent()
+{
+	OrbisKernelEvent evt;
+	int count;
+	
+	return sceKernelWaitEqueue(this->flipQueue, &evt, 1, &count, 0) == 0;
+}
+#endif
+
+bool Scene2D::isBufferFree(int index)
+{
+	// A buffer is free once a newer frame than the one it carries has been flipped to the screen
+	return this->bufferFrameIDs[index] < 0 || this->bufferFrameIDs[index] < this->lastFlipArg;
+}
+
 void Scene2D::FrameBufferSwap()
 {
-	// Swap the frame buffer for some perf
-	this->activeFrameBufferIdx = (this->activeFrameBufferIdx + 1) % 2;
+	int next = (this->activeFrameBufferIdx + 1) % this->numFrameBuffers;
+	
+	if(this->threadedPresent)
+	{
+		// The present thread owns the flip queue, wait for it to report a newer flip
+		pthread_mutex_lock(&this->flipMutex);
+		
+		if(!isBufferFree(next))
+			this->flipStallCount++;
+		
+		while(!isBufferFree(next))
+			pthread_cond_wait(&this->flipCond, &this->flipMutex);
+		
+		pthread_mutex_unlock(&this->flipMutex);
+	}
+	else if(!isBufferFree(next))
+	{
+		// Only block when the next buffer is still queued for flip or being scanned out
+		updateFlipStatus();
+		
+		if(!isBufferFree(next))
+			this->flipStallCount++;
+		
+		while(!isBufferFree(next))
+		{
+			if(!waitFlipEvent())
+				break;
+			
+			updateFlipStatus();
+		}
+	}
+	
+	this->activeFrameBufferIdx = next;
+}
+
+bool Scene2D::SetTargetFrameRate(int hz)
+{
+	if(hz != 20 && hz != 30 && hz != 60)
+		return false;
+	
+	// Before Init the rate is only remembered, Init applies it
+	if(this->video > 0 && !setFlipRate(hz))
+		return false;
+	
+	this->targetFrameRate = hz;
+	this->frameIntervalUsec = 1000000 / hz;
+	this->smoothedFrameUsec = this->frameIntervalUsec;
+	return true;
+}
+
+int Scene2D::GetTargetFrameRate()
+{
+	return this->targetFrameRate;
+}
+
+uint32_t Scene2D::GetFrameTimeUsec()
+{
+	return this->smoothedFrameUsec;
+}
+
+int Scene2D::GetMissedVsyncCount()
+{
+	return this->missedVsyncCount;
+}
+
+void Scene2D::SkipFrame()
+{
+	pthread_mutex_lock(&this->flipMutex);
+	this->skipPending = true;
+	pthread_mutex_unlock(&this->flipMutex);
+}
+
+void Scene2D::recordFlip(uint64_t flipCount, uint64_t flipTimeUsec, int64_t flipArg)
+{
+	if(flipCount == this->lastFlipCount)
+		return;
+	
+	// A frame queued after the app skipped drawing flipped since the last check, its gap was
+	// chosen rather than missed
+	bool resumed = this->resumeFrameID > this->lastMeasuredFrameID && this->resumeFrameID <= flipArg;
+	if(flipArg > this->lastMeasuredFrameID)
+		this->lastMeasuredFrameID = flipArg;
+	
+	if(!resumed && this->lastFlipTime != 0 && flipCount > this->lastFlipCount && flipTimeUsec > this->lastFlipTime)
+	{
+		uint64_t flips = flipCount - this->lastFlipCount;
+		uint64_t gap = flipTimeUsec - this->lastFlipTime;
+		uint64_t intervals = (gap + this->frameIntervalUsec / 2) / this->frameIntervalUsec;
+		
+		// Every interval beyond one per flip is a vsync the screen kept showing an old frame
+		if(intervals <= flips * SCENE2D_PACING_PAUSE_FRAMES)
+		{
+			if(intervals > flips)
+				this->missedVsyncCount += (int)(intervals - flips);
+			
+			int32_t sample = (int32_t)(gap / flips);
+			int32_t smoothed = (int32_t)this->smoothedFrameUsec;
+			this->smoothedFrameUsec = (uint32_t)(smoothed + (sample - smoothed) / SCENE2D_FRAME_TIME_SMOOTHING);
+		}
+	}
+	
+	this->lastFlipCount = flipCount;
+	this->lastFlipTime = flipTimeUsec;
+}
+
+int Scene2D::GetFlipStallCount()
+{
+	return this->flipStallCount;
+}
+
+void Scene2D::FrameBufferClear(Pixel pixel)
+{
+    FrameBufferFill(pixel);
+}
+
+PixelFormat Scene2D::GetPixelFormat()
+{
+	return this->pixelFormat;
 }
 
-void Scene2D::FrameBufferClear(Color color)
+Pixel Scene2D::EncodeColor(Color color)
 {
-    FrameBufferFill(color);
+	return this->pixelEncoder(color);
 }
 
 #ifdef GRAPHICS_USES_FONT
 bool Scene2D::InitFont(FT_Face *face, const char *fontPath, int fontSize)
 {
 	int rc;
+	char path[256];
+	
+	// Bare file names are looked up in the packaged fonts directory
+	if(fontPath[0] != '/')
+	{
+		snprintf(path, sizeof(path), "%s%s", SCENE2D_FONT_DIR, fontPath);
+		fontPath = path;
+	}
 	
 	rc = FT_New_Face(this->ftLib, fontPath, 0, face);
 	
-	if(rc < 0)
+	if(rc != 0)
+	{
+		DEBUGLOG << "Failed to load font " << fontPath << ": " << rc;
 		return false;
+	}
 
 	rc = FT_Set_Pixel_Sizes(*face, 0, fontSize);
 	
-	if(rc < 0)
+	if(rc != 0)
 		return false;
 	
 	return true;
 }
 #endif
 
-void Scene2D::FrameBufferFill(Color color)
+void Scene2D::FrameBufferFill(Pixel pixel)
+{
+	DrawRectangle(0, 0, this->renderWidth, this->renderHeight, pixel);
+}
+
+void Scene2D::DrawPixel(int x, int y, Pixel pixel)
+{
+	DrawRectangle(x, y, 1, 1, pixel);
+}
+
+void Scene2D::DrawRectangle(int x, int y, int w, int h, Pixel pixel)
 {
-	DrawRectangle(0, 0, this->width, this->height, color);
+	if(!this->displayList->AddRect(x, y, w, h, pixel))
+	{
+		flushOverflow();
+		this->displayList->AddRect(x, y, w, h, pixel);
+	}
 }
 
-void Scene2D::DrawPixel(int x, int y, Color color)
+const uint8_t *Scene2D::getCornerMask(int radius)
 {
-	// Get pixel location based on pitch
-	int pixel = (y * this->width) + x;
+	if(this->cornerMasks[radius])
+		return this->cornerMasks[radius];
+	
+	uint8_t *mask = new uint8_t[radius * radius];
 	
-	// Encode to 24-bit color
-	uint32_t encodedColor = 0x80000000 + (color.r << 16) + (color.g << 8) + color.b;
+	// Top-left quarter circle centred on (radius, radius), 4x4 samples per pixel in 1/8 pixel units
+	int r8 = radius * 8;
 	
-	// Draw to the frame buffer
-	((uint32_t *)this->frameBuffers[this->activeFrameBufferIdx])[pixel] = encodedColor;
+	for(int y = 0; y < radius; y++)
+	{
+		for(int x = 0; x < radius; x++)
+		{
+			int inside = 0;
+			
+			for(int sy = 0; sy < 4; sy++)
+			{
+				int dy = y * 8 + sy * 2 + 1 - r8;
+				
+				for(int sx = 0; sx < 4; sx++)
+				{
+					int dx = x * 8 + sx * 2 + 1 - r8;
+					if(dx * dx + dy * dy <= r8 * r8)
+						inside++;
+				}
+			}
+			
+			mask[y * radius + x] = (uint8_t)(inside * 255 / 16);
+		}
+	}
+	
+	this->cornerMasks[radius] = mask;
+	return mask;
 }
 
-void Scene2D::DrawRectangle(int x, int y, int w, int h, Color color)
+void Scene2D::DrawRoundedRectangle(int x, int y, int w, int h, int radius, Pixel pixel)
 {
-	int xPos, yPos;
+	if(radius > w / 2) radius = w / 2;
+	if(radius > h / 2) radius = h / 2;
+	if(radius > SCENE2D_MAX_CORNER_RADIUS) radius = SCENE2D_MAX_CORNER_RADIUS;
+	
+	if(radius <= 0)
+	{
+		DrawRectangle(x, y, w, h, pixel);
+		return;
+	}
+	
+	const uint8_t *mask = getCornerMask(radius);
+	int r = radius;
 	
-	// Draw row-by-row, column-by-column
-	for(yPos = y; yPos < y + h; yPos++)
+	DrawRectangle(x + r, y, w - 2 * r, r, pixel);
+	DrawRectangle(x, y + r, w, h - 2 * r, pixel);
+	DrawRectangle(x + r, y + h - r, w - 2 * r, r, pixel);
+	
+	const int corners[4][4] = {
+		{ x,         y,         0, 0 },
+		{ x + w - r, y,         1, 0 },
+		{ x,         y + h - r, 0, 1 },
+		{ x + w - r, y + h - r, 1, 1 }
+	};
+	
+	for(int i = 0; i < 4; i++)
 	{
-		for(xPos = x; xPos < x + w; xPos++)
+		const int *c = corners[i];
+		
+		if(!this->displayList->AddMask(c[0], c[1], r, r, mask, r, radius, c[2], c[3], pixel))
 		{
-			DrawPixel(xPos, yPos, color);
+			flushOverflow();
+			this->displayList->AddMask(c[0], c[1], r, r, mask, r, radius, c[2], c[3], pixel);
 		}
 	}
 }
 
+void Scene2D::DrawBlendedRectangle(int x, int y, int w, int h, Pixel pixel)
+{
+	if(!this->displayList->AddBlendRect(x, y, w, h, pixel))
+	{
+		flushOverflow();
+		this->displayList->AddBlendRect(x, y, w, h, pixel);
+	}
+}
+
+void Scene2D::DrawGlyphRun(const BitmapFont *font, const char *text, int x, int y, int scale, Pixel pixel)
+{
+	DrawGlyphRun(font, text, strlen(text), x, y, scale, pixel);
+}
+
+void Scene2D::DrawGlyphRun(const BitmapFont *font, const char *text, int length, int x, int y, int scale, Pixel pixel)
+{
+	if(!this->displayList->AddGlyphRun(font, text, length, x, y, scale, pixel))
+	{
+		flushOverflow();
+		this->displayList->AddGlyphRun(font, text, length, x, y, scale, pixel);
+	}
+}
+
+void Scene2D::DrawSprite(const uint32_t *pixels, int pitch, int srcWidth, int srcHeight, uint32_t contentID, int x, int y, int w, int h)
+{
+	if(!this->displayList->AddSprite(pixels, pitch, srcWidth, srcHeight, contentID, x, y, w, h, SPRITE_COPY, 0))
+	{
+		flushOverflow();
+		this->displayList->AddSprite(pixels, pitch, srcWidth, srcHeight, contentID, x, y, w, h, SPRITE_COPY, 0);
+	}
+}
+
+void Scene2D::DrawBlendedSprite(const uint32_t *pixels, int pitch, int srcWidth, int srcHeight, uint32_t contentID, int x, int y, int w, int h)
+{
+	if(!this->displayList->AddSprite(pixels, pitch, srcWidth, srcHeight, contentID, x, y, w, h, SPRITE_BLEND, 0))
+	{
+		flushOverflow();
+		this->displayList->AddSprite(pixels, pitch, srcWidth, srcHeight, contentID, x, y, w, h, SPRITE_BLEND, 0);
+	}
+}
+
+void Scene2D::Blit(const Surface *src, int x, int y)
+{
+	addSurfaceSprite(src, 0, 0, src->width, src->height, x, y, SPRITE_COPY, 0);
+}
+
+void Scene2D::Blit(const Surface *src, int srcX, int srcY, int w, int h, int x, int y)
+{
+	addSurfaceSprite(src, srcX, srcY, w, h, x, y, SPRITE_COPY, 0);
+}
+
+void Scene2D::BlitColorKey(const Surface *src, int srcX, int srcY, int w, int h, int x, int y, Pixel key)
+{
+	addSurfaceSprite(src, srcX, srcY, w, h, x, y, SPRITE_COLOR_KEY, key);
+}
+
+void Scene2D::BlitBlend(const Surface *src, int srcX, int srcY, int w, int h, int x, int y)
+{
+	addSurfaceSprite(src, srcX, srcY, w, h, x, y, SPRITE_BLEND, 0);
+}
+
+void Scene2D::addSurfaceSprite(const Surface *src, int srcX, int srcY, int w, int h, int x, int y, int mode, Pixel key)
+{
+	// Keep the source rect inside the surface, the destination is clipped when recorded
+	if(srcX < 0) { x -= srcX; w += srcX; srcX = 0; }
+	if(srcY < 0) { y -= srcY; h += srcY; srcY = 0; }
+	if(w > src->width - srcX) w = src->width - srcX;
+	if(h > src->height - srcY) h = src->height - srcY;
+	
+	if(w <= 0 || h <= 0)
+		return;
+	
+	const uint32_t *pixels = src->pixels + srcY * src->pitch + srcX;
+	
+	if(!this->displayList->AddSprite(pixels, src->pitch, w, h, src->contentID, x, y, w, h, (SpriteMode)mode, key))
+	{
+		flushOverflow();
+		this->displayList->AddSprite(pixels, src->pitch, w, h, src->contentID, x, y, w, h, (SpriteMode)mode, key);
+	}
+}
+
+void Scene2D::flushOverflow()
+{
+	// The frame no longer fits one list, so band hashes can't describe the buffer contents
+	this->diffBands = false;
+	executeDisplayList();
+	
+	if(this->renderTarget == NULL)
+		invalidateBands(this->backBuffer != NULL ? this->backHashes : this->bandHashes[this->activeFrameBufferIdx]);
+}
+
+void Scene2D::invalidateBands(uint64_t *hashes)
+{
+	// Tokens that no command hash or other band will match, so the bands get redrawn and resolved
+	for(int band = 0; band < this->numBands; band++)
+		hashes[band] = this->nextStaleHash++;
+}
+
+void Scene2D::FlushDrawList()
+{
+	executeDisplayList();
+	this->diffBands = true;
+}
+
+void Scene2D::SetRenderTarget(Surface *surface)
+{
+	// Anything already recorded belongs to the previous target
+	if(!this->displayList->IsEmpty())
+		FlushDrawList();
+	
+	this->renderTarget = surface;
+	applyClip();
+}
+
+bool Scene2D::PushClipRect(int x, int y, int w, int h)
+{
+	if(this->clipDepth == SCENE2D_MAX_CLIP_DEPTH)
+		return false;
+	
+	// 64-bit so far-off rects can't wrap around, clamped back to what an int holds
+	int64_t x1 = (int64_t)x + (w > 0 ? w : 0);
+	int64_t y1 = (int64_t)y + (h > 0 ? h : 0);
+	
+	ClipRect rect = { x, y, x1 < INT32_MAX ? (int)x1 : INT32_MAX, y1 < INT32_MAX ? (int)y1 : INT32_MAX };
+	
+	if(this->clipDepth > 0)
+	{
+		const ClipRect *outer = &this->clipStack[this->clipDepth - 1];
+		
+		if(rect.x0 < outer->x0) rect.x0 = outer->x0;
+		if(rect.y0 < outer->y0) rect.y0 = outer->y0;
+		if(rect.x1 > outer->x1) rect.x1 = outer->x1;
+		if(rect.y1 > outer->y1) rect.y1 = outer->y1;
+	}
+	
+	this->clipStack[this->clipDepth++] = rect;
+	applyClip();
+	return true;
+}
+
+void Scene2D::PopClipRect()
+{
+	if(this->clipDepth > 0)
+		this->clipDepth--;
+	
+	applyClip();
+}
+
+void Scene2D::applyClip()
+{
+	// The target bounds always apply, so recorded commands can never reach outside it
+	ClipRect clip = { 0, 0, this->renderWidth, this->renderHeight };
+	
+	if(this->renderTarget != NULL)
+	{
+		clip.x1 = this->renderTarget->width;
+		clip.y1 = this->renderTarget->height;
+	}
+	
+	if(this->clipDepth > 0)
+	{
+		const ClipRect *top = &this->clipStack[this->clipDepth - 1];
+		
+		if(top->x0 > clip.x0) clip.x0 = top->x0;
+		if(top->y0 > clip.y0) clip.y0 = top->y0;
+		if(top->x1 < clip.x1) clip.x1 = top->x1;
+		if(top->y1 < clip.y1) clip.y1 = top->y1;
+	}
+	
+	this->displayList->SetClip(clip.x0, clip.y0, clip.x1, clip.y1);
+}
+
+void Scene2D::executeDisplayList()
+{
+	// Resolve where this flush lands, only frame buffers are diffed against earlier frames
+	if(this->renderTarget != NULL)
+	{
+		this->flushTarget = *this->renderTarget;
+		this->flushDiff = false;
+		
+		// Anything showing this surface has to be redrawn
+		this->renderTarget->contentID = this->nextContentID++;
+	}
+	else
+	{
+		this->flushTarget.width = this->width;
+		this->flushTarget.height = this->height;
+		this->flushTarget.pitch = this->width;
+		this->flushTarget.pixels = (uint32_t *)this->frameBuffers[this->activeFrameBufferIdx];
+		this->flushDiff = this->diffBands;
+		this->flushHashes = this->bandHashes[this->activeFrameBufferIdx];
+		
+		if(this->backBuffer != NULL)
+		{
+			this->flushTarget.width = this->renderWidth;
+			this->flushTarget.height = this->renderHeight;
+			this->flushTarget.pitch = this->renderWidth;
+			this->flushTarget.pixels = this->backBuffer;
+			this->flushHashes = this->backHashes;
+		}
+	}
+	
+	int bands = (this->flushTarget.height + SCENE2D_BAND_HEIGHT - 1) / SCENE2D_BAND_HEIGHT;
+	
+	if(this->rasterPool != NULL)
+		this->rasterPool->Run(rasterBandJob, this, bands);
+	else
+	{
+		for(int band = 0; band < bands; band++)
+			rasterBandJob(this, band);
+	}
+	
+	this->skippedBandCount = 0;
+	if(this->flushDiff)
+	{
+		for(int band = 0; band < bands; band++)
+			this->skippedBandCount += this->bandSkipped[band];
+	}
+	
+	this->displayList->Reset();
+	
 #ifdef GRAPHICS_USES_FONT
-void Scene2D::DrawText(char *txt, FT_Face face, int startX, int startY, Color bgColor, Color fgColor)
+	// Glyphs referenced before this point may now be recycled
+	this->flushEpoch++;
+#endif
+}
+
+void Scene2D::rasterBandJob(void *arg, int band)
 {
-	int rc;
-	int xOffset = 0;
-	int yOffset = 0;
+	Scene2D *scene = (Scene2D *)arg;
+	const Surface *target = &scene->flushTarget;
 	
-	// Get the glyph slot for bitmap and font metrics
-	FT_GlyphSlot slot = face->glyph;
+	int bandY0 = band * SCENE2D_BAND_HEIGHT;
+	int bandY1 = bandY0 + SCENE2D_BAND_HEIGHT;
+	
+	if(bandY1 > target->height)
+		bandY1 = target->height;
 	
-	// Iterate each character of the text to write to the screen
-	for(int n = 0; n < strlen(txt); n++)
+	// Leave the band alone if this buffer already holds exactly what the commands would draw
+	if(scene->flushDiff)
 	{
-		FT_UInt glyph_index;
+		uint64_t *hashes = scene->flushHashes;
+		uint64_t hash = scene->displayList->HashBand(bandY0, bandY1);
+		
+		scene->bandSkipped[band] = (hashes[band] == hash);
+		
+		if(scene->bandSkipped[band])
+			return;
+		
+		hashes[band] = hash;
+	}
+	
+	scene->displayList->ExecuteBand(target->pixels, target->pitch, bandY0, bandY1);
+}
 
-        // Get the glyph for the ASCII code
-        glyph_index = FT_Get_Char_Index(face, txt[n]);
+void Scene2D::InvalidateFrame()
+{
+	if(this->backBuffer != NULL)
+		invalidateBands(this->backHashes);
+	
+	for(int i = 0; i < this->numFrameBuffers; i++)
+		invalidateBands(this->bandHashes[i]);
+}
 
-        // Load and render in 8-bit color
-        rc = FT_Load_Glyph(face, glyph_index, FT_LOAD_DEFAULT);
+int Scene2D::GetSkippedBandCount()
+{
+	return this->skippedBandCount;
+}
 
-        if (rc)
-            continue;
+bool Scene2D::SetCacheableBackBuffer(bool enabled)
+{
+	if(enabled)
+		return this->backBuffer != NULL || allocateBackBuffer();
+	
+	// Scaled rendering can't draw straight into the frame buffers
+	if(this->renderScale > 1)
+		return false;
+	
+	free(this->backBuffer);
+	this->backBuffer = NULL;
+	return true;
+}
 
-        rc = FT_Render_Glyph(slot, ft_render_mode_normal);
+bool Scene2D::SetRenderScale(int factor)
+{
+	if(factor < 1 || factor > SCENE2D_MAX_RENDER_SCALE || this->width % factor != 0 || this->height % factor != 0)
+		return false;
+	
+	if(factor == this->renderScale)
+		return true;
+	
+	int oldScale = this->renderScale;
+	this->renderScale = factor;
+	this->renderWidth = this->width / factor;
+	this->renderHeight = this->height / factor;
+	
+	if(!allocateBackBuffer())
+	{
+		// Fall back to the previous scale, the smaller buffer may still fit
+		this->renderScale = oldScale;
+		this->renderWidth = this->width / oldScale;
+		this->renderHeight = this->height / oldScale;
+		allocateBackBuffer();
+		return false;
+	}
+	
+	// Frame buffer bands no longer line up with back buffer bands
+	for(int i = 0; i < this->numFrameBuffers; i++)
+		invalidateBands(this->bandHashes[i]);
+	
+	applyClip();
+	return true;
+}
 
-        if (rc)
-            continue;
+int Scene2D::GetWidth()
+{
+	return this->renderWidth;
+}
 
-        // If we get a newline, increment the y offset, reset the x offset, and skip to the next character
-        if (txt[n] == '\n')
-        {
-            xOffset = 0;
-            yOffset += slot->bitmap.width * 2;
+int Scene2D::GetHeight()
+{
+	return this->renderHeight;
+}
 
-            continue;
-        }
+bool Scene2D::allocateBackBuffer()
+{
+	free(this->backBuffer);
+	
+	// Cache line aligned so the resolve can use aligned 16-byte loads
+	if(posix_memalign((void **)&this->backBuffer, 64, this->renderWidth * this->renderHeight * sizeof(uint32_t)) != 0)
+	{
+		this->backBuffer = NULL;
+		return false;
+	}
+	
+	invalidateBands(this->backHashes);
+	return true;
+}
 
-        // Parse and write the bitmap to the frame buffer
-        for (int yPos = 0; yPos < slot->bitmap.rows; yPos++)
-        {
-            for (int xPos = 0; xPos < slot->bitmap.width; xPos++)
-            {
-                // Decode the 8-bit bitmap
-                char pixel = slot->bitmap.buffer[(yPos * slot->bitmap.width) + xPos];
+void Scene2D::CopyFrame(uint32_t *pixels, int pitch)
+{
+	// Without a back buffer there is no render scale, so both are renderWidth wide
+	const uint32_t *src = this->backBuffer ? this->backBuffer : (const uint32_t *)this->frameBuffers[this->activeFrameBufferIdx];
+	
+	if(pitch == this->renderWidth)
+	{
+		memcpy(pixels, src, (size_t)this->renderWidth * this->renderHeight * sizeof(uint32_t));
+		return;
+	}
+	
+	for(int y = 0; y < this->renderHeight; y++)
+		memcpy(pixels + (size_t)y * pitch, src + (size_t)y * this->renderWidth, this->renderWidth * sizeof(uint32_t));
+}
 
-                // Get new pixel coordinates to account for the character position and baseline, as well as newlines
-                int x = startX + xPos + xOffset + slot->bitmap_left;
-                int y = startY + yPos + yOffset - slot->bitmap_top;
+void Scene2D::CopyFrameScaled(uint32_t *pixels, int pitch, int factor)
+{
+	const uint32_t *src = this->backBuffer ? this->backBuffer : (const uint32_t *)this->frameBuffers[this->activeFrameBufferIdx];
+	int w = this->renderWidth / factor;
+	int h = this->renderHeight / factor;
+	
+	for(int y = 0; y < h; y++)
+	{
+		const uint32_t *row = src + (size_t)y * factor * this->renderWidth;
+		uint32_t *dst = pixels + (size_t)y * pitch;
+		
+		for(int x = 0; x < w; x++)
+			dst[x] = row[x * factor];
+	}
+}
 
-                // Linearly interpolate between the foreground and background for smoother rendering
-				uint8_t r = (pixel * fgColor.r) / 255;
-				uint8_t g = (pixel * fgColor.g) / 255;
-				uint8_t b = (pixel * fgColor.b) / 255;
+int Scene2D::GetResolvedBandCount()
+{
+	return this->resolvedBandCount;
+}
 
-                // Create new color struct with lerp'd values
-                Color finalColor = { r, g, b };
+uint32_t Scene2D::GetResolveUsec()
+{
+	return this->resolveUsec;
+}
 
-                // We need to do bounds checking before commiting the pixel write due to our transformations, or we
-                // could write out-of-bounds of the frame buffer
-                if (x < 0 || y < 0 || x >= this->width || y >= this->height)
-                    continue;
+// Copies a row with non-temporal stores, so display memory is written in full lines without
+// polluting the cache. Both rows must be 16-byte aligned.
+static void streamRow(uint32_t *dst, const uint32_t *src, int count)
+{
+#if defined(__SSE2__)
+	int i = 0;
+	
+	for(; i + 16 <= count; i += 16)
+	{
+		__m128i a = _mm_load_si128((const __m128i *)(src + i));
+		__m128i b = _mm_load_si128((const __m128i *)(src + i + 4));
+		__m128i c = _mm_load_si128((const __m128i *)(src + i + 8));
+		__m128i d = _mm_load_si128((const __m128i *)(src + i + 12));
+		_mm_stream_si128((__m128i *)(dst + i), a);
+		_mm_stream_si128((__m128i *)(dst + i + 4), b);
+		_mm_stream_si128((__m128i *)(dst + i + 8), c);
+		_mm_stream_si128((__m128i *)(dst + i + 12), d);
+	}
+	
+	for(; i < count; i++)
+		dst[i] = src[i];
+#else
+	memcpy(dst, src, count * sizeof(uint32_t));
+#endif
+}
 
-                // If the pixel in the bitmap isn't blank, we'll draw it
-                if(pixel != 0x00)
-                    this->DrawPixel(x, y, finalColor);
-            }
-        }
+// Replicates every source pixel factor times into dst with non-temporal stores. dst must be
+// 16-byte aligned, src needn't be since scaled rows can have any width.
+static void upscaleRow(uint32_t *dst, const uint32_t *src, int count, int factor)
+{
+	int i = 0;
+	
+#if defined(__SSE2__)
+	// Four source pixels become 2, 3 or 4 registers of output
+	for(; i + 4 <= count; i += 4, dst += 4 * factor)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i *)(src + i));
+		
+		switch(factor)
+		{
+			case 2:
+				_mm_stream_si128((__m128i *)dst, _mm_unpacklo_epi32(a, a));
+				_mm_stream_si128((__m128i *)(dst + 4), _mm_unpackhi_epi32(a, a));
+				break;
+			case 3:
+				_mm_stream_si128((__m128i *)dst, _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 0, 0, 0)));
+				_mm_stream_si128((__m128i *)(dst + 4), _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 2, 1, 1)));
+				_mm_stream_si128((__m128i *)(dst + 8), _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 3, 3, 2)));
+				break;
+			default:
+				_mm_stream_si128((__m128i *)dst, _mm_shuffle_epi32(a, _MM_SHUFFLE(0, 0, 0, 0)));
+				_mm_stream_si128((__m128i *)(dst + 4), _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 1, 1, 1)));
+				_mm_stream_si128((__m128i *)(dst + 8), _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 2, 2, 2)));
+				_mm_stream_si128((__m128i *)(dst + 12), _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 3, 3, 3)));
+				break;
+		}
+	}
+#endif
+	
+	for(; i < count; i++)
+	{
+		for(int k = 0; k < factor; k++)
+			*dst++ = src[i];
+	}
+}
 
-        // Increment x offset for the next character
-        xOffset += slot->advance.x >> 6;
-    }
+void Scene2D::resolveBackBuffer()
+{
+	uint64_t start = GetTimeUsec();
+	int bands = (this->renderHeight + SCENE2D_BAND_HEIGHT - 1) / SCENE2D_BAND_HEIGHT;
+	
+	if(this->rasterPool != NULL)
+		this->rasterPool->Run(resolveBandJob, this, bands);
+	else
+	{
+		for(int band = 0; band < bands; band++)
+			resolveBandJob(this, band);
+	}
+	
+	// bandSkipped now flags the bands the frame buffer already held
+	this->resolvedBandCount = 0;
+	for(int band = 0; band < bands; band++)
+		this->resolvedBandCount += !this->bandSkipped[band];
+	
+	this->resolveUsec = (uint32_t)(GetTimeUsec() - start);
+}
+
+void Scene2D::resolveBandJob(void *arg, int band)
+{
+	Scene2D *scene = (Scene2D *)arg;
+	uint64_t *hashes = scene->bandHashes[scene->activeFrameBufferIdx];
+	
+	scene->bandSkipped[band] = (hashes[band] == scene->backHashes[band]);
+	
+	if(scene->bandSkipped[band])
+		return;
+	
+	int y0 = band * SCENE2D_BAND_HEIGHT;
+	int y1 = y0 + SCENE2D_BAND_HEIGHT;
+	
+	if(y1 > scene->renderHeight)
+		y1 = scene->renderHeight;
+	
+	uint32_t *dst = (uint32_t *)scene->frameBuffers[scene->activeFrameBufferIdx];
+	int scale = scene->renderScale;
+	
+	for(int y = y0; y < y1; y++)
+	{
+		const uint32_t *src = scene->backBuffer + y * scene->renderWidth;
+		
+		if(scale == 1)
+		{
+			streamRow(dst + y * scene->width, src, scene->width);
+			continue;
+		}
+		
+		// Each back buffer row becomes scale identical frame buffer rows
+		for(int k = 0; k < scale; k++)
+			upscaleRow(dst + (y * scale + k) * scene->width, src, scene->renderWidth, scale);
+	}
+	
+#if defined(__SSE2__)
+	// Drain this thread's write-combining buffers before the flip can be submitted
+	_mm_sfence();
+#endif
+	
+	hashes[band] = scene->backHashes[band];
+}
+
+#ifdef GRAPHICS_USES_FONT
+// Decodes one UTF-8 sequence and advances past it, malformed bytes are passed through as-is
+static uint32_t decodeUTF8(const unsigned char **text)
+{
+	const unsigned char *p = *text;
+	uint32_t codepoint = *p++;
+	int extra = 0;
+	
+	if(codepoint >= 0xF0 && codepoint < 0xF8)      { codepoint &= 0x07; extra = 3; }
+	else if(codepoint >= 0xE0 && codepoint < 0xF0) { codepoint &= 0x0F; extra = 2; }
+	else if(codepoint >= 0xC0 && codepoint < 0xE0) { codepoint &= 0x1F; extra = 1; }
+	
+	for(int i = 0; i < extra; i++)
+	{
+		if((*p & 0xC0) != 0x80)
+			break;
+		
+		codepoint = (codepoint << 6) | (*p++ & 0x3F);
+	}
+	
+	*text = p;
+	return codepoint;
+}
+
+CachedGlyph *Scene2D::getGlyph(FT_Face face, int size, uint32_t codepoint)
+{
+	CachedGlyph *glyph = this->glyphCache->Find(face, size, codepoint);
+	
+	if(glyph)
+		return glyph;
+	
+	// Recycling a bitmap that pending commands still point at means drawing them first
+	CachedGlyph *victim = this->glyphCache->Victim();
+	
+	if(victim && victim->usedEpoch == this->flushEpoch && !this->displayList->IsEmpty())
+		flushOverflow();
+	
+	if(face->size->metrics.y_ppem != size && FT_Set_Pixel_Sizes(face, 0, size) != 0)
+		return NULL;
+	
+	if(FT_Load_Char(face, codepoint, FT_LOAD_RENDER) != 0)
+		return NULL;
+	
+	FT_GlyphSlot slot = face->glyph;
+	FT_Bitmap *bitmap = &slot->bitmap;
+	
+	glyph = this->glyphCache->Insert(face, size, codepoint);
+	glyph->left = slot->bitmap_left;
+	glyph->top = slot->bitmap_top;
+	glyph->advance = slot->advance.x >> 6;
+	
+	if(this->glyphCache->Reserve(glyph, bitmap->width * bitmap->rows))
+	{
+		glyph->width = bitmap->width;
+		glyph->rows = bitmap->rows;
+		
+		for(int y = 0; y < (int)bitmap->rows; y++)
+			memcpy(glyph->coverage + y * bitmap->width, bitmap->buffer + y * bitmap->pitch, bitmap->width);
+	}
+	
+	return glyph;
+}
+
+void Scene2D::DrawText(const char *txt, FT_Face face, int size, int startX, int startY, Pixel pixel)
+{
+	const unsigned char *p = (const unsigned char *)txt;
+	int x = startX;
+	int y = startY;
+	
+	// Design units are plain fields of the face, so line spacing needs no FreeType call
+	int lineHeight = (int)((face->height * size + face->units_per_EM - 1) / face->units_per_EM);
+	
+	while(*p)
+	{
+		uint32_t codepoint = decodeUTF8(&p);
+		
+		if(codepoint == '\n')
+		{
+			x = startX;
+			y += lineHeight;
+			continue;
+		}
+		
+		// Cached glyphs cost no FreeType calls, their coverage is blended straight from the cache
+		CachedGlyph *glyph = getGlyph(face, size, codepoint);
+		
+		if(!glyph)
+			continue;
+		
+		if(glyph->width > 0 && glyph->rows > 0)
+		{
+			int gx = x + glyph->left;
+			int gy = y - glyph->top;
+			
+			if(!this->displayList->AddMask(gx, gy, glyph->width, glyph->rows, glyph->coverage, glyph->width, glyph->contentID, false, false, pixel))
+			{
+				flushOverflow();
+				this->displayList->AddMask(gx, gy, glyph->width, glyph->rows, glyph->coverage, glyph->width, glyph->contentID, false, false, pixel);
+			}
+			
+			glyph->usedEpoch = this->flushEpoch;
+		}
+		
+		x += glyph->advance;
+	}
 }
 #endif
 
@@ -1,6 +1,18 @@
 #include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+// SCENE2D_HEADLESS builds Scene2D for a host OS: frame buffers live in plain memory,
+// flips complete immediately and can be dumped to image files (see graphics_headless.cpp)
+#ifndef SCENE2D_HEADLESS
 #include <orbis/VideoOut.h>
 #include <orbis/libkernel.h>
+#endif
+
+#ifdef GRAPHICS_USES_FONT
+#include <orbis/Sysmodule.h>
+#include <proto-include.h>
+#endif
 
 #ifndef GRAPHICS_H
 #define GRAPHICS_H
@@ -13,6 +25,84 @@ struct Color {
     uint8_t a;  // Alpha channel
 };
 
+// Pixel is a color already encoded in the frame buffer's native 32-bit format, premultiplied by alpha
+typedef uint32_t Pixel;
+
+// Frame buffer pixel formats, as passed to sceVideoOutSetBufferAttribute
+enum PixelFormat {
+    PIXEL_FORMAT_A8R8G8B8_SRGB = 0x80000000,
+    PIXEL_FORMAT_A8B8G8R8_SRGB = 0x80002200
+};
+
+// Image files written by frame dumps and screenshots
+enum ImageFileFormat {
+    IMAGE_FILE_PPM,
+    IMAGE_FILE_PNG
+};
+
+// Converts a Color into a native Pixel for one specific pixel format
+typedef Pixel (*PixelEncoder)(Color color);
+
+// Supported range for the number of frame buffers
+#define SCENE2D_MIN_FRAME_BUFFERS 2
+#define SCENE2D_MAX_FRAME_BUFFERS 4
+
+// Flip pacing: the rate used until SetTargetFrameRate, how strongly the measured frame time is
+// smoothed (new samples weigh 1/N), and the gap in frames beyond which no flip is a pause
+// rather than missed vsyncs, for apps that skip frames without calling SkipFrame
+#define SCENE2D_DEFAULT_FRAME_RATE 60
+#define SCENE2D_FRAME_TIME_SMOOTHING 16
+#define SCENE2D_PACING_PAUSE_FRAMES 8
+
+// Rows per rasteriser band, bands are the unit of work handed to raster threads
+#define SCENE2D_BAND_HEIGHT 40
+
+// Arena backing the per-frame display list, it is flushed early if a frame overflows it
+#define SCENE2D_DISPLAY_LIST_SIZE (1024 * 1024)
+
+// Largest integer factor between the drawing resolution and the frame buffers
+#define SCENE2D_MAX_RENDER_SCALE 4
+
+// Nesting limit for PushClipRect
+#define SCENE2D_MAX_CLIP_DEPTH 16
+
+// Largest corner radius with a cached coverage mask, larger radii are clamped
+#define SCENE2D_MAX_CORNER_RADIUS 64
+
+// Font files passed to InitFont by bare name are loaded from here
+#define SCENE2D_FONT_DIR "/app0/assets/fonts/"
+
+// Fixed-cell 1bpp font, each glyph row is a bit mask with the leftmost pixel in the highest used bit
+struct BitmapFont {
+    const uint8_t *glyphs[128];     // NULL glyphs advance without drawing
+    int glyphWidth;
+    int glyphHeight;
+    int advance;                    // Cell advance in font pixels
+};
+
+// Half-open pixel rectangle [x0, x1) x [y0, y1)
+struct ClipRect {
+    int x0, y0;
+    int x1, y1;
+};
+
+// Offscreen pixels in the frame buffer's native format, pitch is in pixels
+struct Surface {
+    int width;
+    int height;
+    int pitch;
+    uint32_t *pixels;
+    uint32_t contentID;     // Changed by Scene2D whenever draws land in the surface
+};
+
+// Surface rows start on this boundary so blits can use aligned vector loads
+#define SCENE2D_SURFACE_ALIGN 64
+
+class WorkerPool;
+class DisplayList;
+class GlyphCache;
+struct CachedGlyph;
+
 class Scene2D
 {
 private:
@@ -28,32 +118,252 @@ private:
     
     size_t frameBufferSize;
     int activeFrameBufferIdx;
+    int numFrameBuffers;
+    
+    // Frame ID last submitted from each buffer (-1 if never), and the last completed flip
+    int bufferFrameIDs[SCENE2D_MAX_FRAME_BUFFERS];
+    int64_t lastFlipArg;
+    int flipStallCount;
+    
+    // Frame pacing, measured from the flip count and time the video out reports
+    int targetFrameRate;
+    uint32_t frameIntervalUsec;
+    uint64_t lastFlipCount;
+    uint64_t lastFlipTime;
+    uint32_t smoothedFrameUsec;
+    int missedVsyncCount;
+    
+    // The first frame queued after a SkipFrame, the gap before its flip is a pause. Flips
+    // are only measured once the newest frame they report is past lastMeasuredFrameID.
+    bool skipPending;
+    int64_t resumeFrameID;
+    int64_t lastMeasuredFrameID;
+    
+    // Guards the flip bookkeeping when flips are submitted from a present thread
+    pthread_mutex_t flipMutex;
+    pthread_cond_t flipCond;
+    bool threadedPresent;
     
     char **frameBuffers;
+    PixelFormat pixelFormat;
+    PixelEncoder pixelEncoder;
+#ifndef SCENE2D_HEADLESS
     OrbisVideoOutBufferAttribute attr;
     OrbisKernelEqueue flipQueue;
+    off_t surfaceMemOff;
+#else
+    // Flipped frames are written here when enabled, as <prefix>NNNNNN.<ext>
+    char dumpPrefix[256];
+    ImageFileFormat dumpFormat;
+    bool dumpFrames;
+#endif
+    
+    DisplayList *displayList;
+    WorkerPool *rasterPool;
+    
+    // Hash of the commands that produced each band of each frame buffer, to skip unchanged bands
+    int numBands;
+    uint64_t *bandHashes[SCENE2D_MAX_FRAME_BUFFERS];
+    uint8_t *bandSkipped;
+    bool diffBands;
+    int skippedBandCount;
+    
+    // Offscreen target for recorded draws, NULL for the active frame buffer
+    Surface *renderTarget;
+    Surface flushTarget;
+    
+    // Cacheable direct memory that offscreen surfaces are bump allocated from
+    uint8_t *surfaceMem;
+    size_t surfaceMemSize;
+    size_t surfaceMemUsed;
+    uint32_t nextContentID;
+    
+    // Nested clip rects, each already intersected with the one below it. Draws are clipped
+    // against the top one and the target bounds when recorded.
+    ClipRect clipStack[SCENE2D_MAX_CLIP_DEPTH];
+    int clipDepth;
+    bool flushDiff;
+    uint64_t *flushHashes;
+    
+    // Cacheable system-memory copy of the frame that draws land in when enabled. Its bands are
+    // hashed like a frame buffer's, and QueueFrame streams only the bands the active frame
+    // buffer doesn't already hold into write-combined display memory.
+    uint32_t *backBuffer;
+    uint64_t *backHashes;
+    
+    // Draws happen at 1/renderScale of the frame buffer size, the resolve upscales by that factor
+    int renderScale;
+    int renderWidth;
+    int renderHeight;
+    uint64_t nextStaleHash;
+    int resolvedBandCount;
+    uint32_t resolveUsec;
+    
+    // Anti-aliased quarter-circle coverage per radius, built on first use
+    uint8_t *cornerMasks[SCENE2D_MAX_CORNER_RADIUS + 1];
+    
+#ifdef GRAPHICS_USES_FONT
+    FT_Library ftLib;
+    
+    // Rendered glyph bitmaps, and a counter of display list flushes so cached
+    // bitmaps still referenced by recorded commands are never recycled
+    GlyphCache *glyphCache;
+    uint32_t flushEpoch;
+#endif
     
     bool initFlipQueue();
     bool allocateVideoMem(size_t size, int alignment);
     bool allocateFrameBuffers(int num);
+    bool registerFrameBuffers();
     char *allocateDisplayMem(size_t size);
     void deallocateVideoMem();
+    bool allocateSurfaceMem(size_t size);
+    void deallocateSurfaceMem();
+    
+    bool setFlipRate(int hz);
+    void recordFlip(uint64_t flipCount, uint64_t flipTimeUsec, int64_t flipArg);
+    void updateFlipStatus();
+    bool waitFlipEvent();
+    bool isBufferFree(int index);
+    
+    void flushOverflow();
+    const uint8_t *getCornerMask(int radius);
+#ifdef GRAPHICS_USES_FONT
+    CachedGlyph *getGlyph(FT_Face face, int size, uint32_t codepoint);
+#endif
+    bool allocateBackBuffer();
+    void invalidateBands(uint64_t *hashes);
+    void applyClip();
+    void addSurfaceSprite(const Surface *src, int srcX, int srcY, int w, int h, int x, int y, int mode, Pixel key);
+    void executeDisplayList();
+    void resolveBackBuffer();
+    static void rasterBandJob(void *arg, int band);
+    static void resolveBandJob(void *arg, int band);
 
 public:
-    Scene2D(int w, int h, int pixelDepth);
+    Scene2D(int w, int h, int pixelDepth, PixelFormat format = PIXEL_FORMAT_A8R8G8B8_SRGB);
+    ~Scene2D();
     
     bool Init(size_t memSize, int numFrameBuffers);
     
+    // Spread rasterisation of recorded draws over this many threads (including the caller)
+    bool SetRasterThreads(int numThreads);
+    
+    // Draws are recorded, this rasterises them into the active frame buffer and joins
+    void FlushDrawList();
+    
+    // Reserve memory for offscreen surfaces. CreateSurface carves surfaces out of it, and
+    // they live as long as the scene.
+    bool InitSurfaceArena(size_t size);
+    bool CreateSurface(Surface *surface, int w, int h);
+    
+    // Redirect recorded draws to an offscreen surface until set back to NULL
+    void SetRenderTarget(Surface *surface);
+    
+    // Restrict drawing to the intersection of this rect and the current clip, until the matching
+    // Pop. Returns false if the stack is full, in which case nothing is pushed.
+    bool PushClipRect(int x, int y, int w, int h);
+    void PopClipRect();
+    
+    // Bands the last flush left alone because they matched what the buffer already shows
+    int GetSkippedBandCount();
+    
+    // Forget what the back buffer and frame buffers hold, so the next frames redraw and
+    // resolve every band. For benchmarks, or after writing to the buffers directly.
+    void InvalidateFrame();
+    
+    // Draw into a cacheable back buffer and resolve dirty bands into display memory on QueueFrame
+    bool SetCacheableBackBuffer(bool enabled);
+    
+    // Draw at 1/factor of the frame buffer size and upscale with pixel replication on resolve.
+    // Needs the back buffer, and factor must divide both frame buffer dimensions.
+    bool SetRenderScale(int factor);
+    
+    // Resolution draws are made in, smaller than the frame buffer when a render scale is set
+    int GetWidth();
+    int GetHeight();
+    
+    // Copies the frame last passed to QueueFrame at drawing resolution (GetWidth x GetHeight),
+    // so call it before FrameBufferSwap. The back buffer is read when there is one, reads from
+    // write-combined display memory are uncached and several times slower.
+    void CopyFrame(uint32_t *pixels, int pitch);
+    
+    // Point-sampled CopyFrame, keeping every factor-th pixel of every factor-th row
+    void CopyFrameScaled(uint32_t *pixels, int pitch, int factor);
+    
+    // Bands copied and time spent by the last resolve
+    int GetResolvedBandCount();
+    uint32_t GetResolveUsec();
+    
+    PixelFormat GetPixelFormat();
+    Pixel EncodeColor(Color color);
+    
     void SetActiveFrameBuffer(int index);
+    
+    // Present from a dedicated thread: FrameBufferSwap then waits on that thread's FrameWait
+    void SetThreadedPresent(bool enabled);
+    
+    // Marks the active buffer as carrying frameID, returns its index for SubmitFlip
+    int QueueFrame(int frameID);
+    
     void SubmitFlip(int frameID);
+    void SubmitFlip(int bufferIndex, int frameID);
     void FrameWait(int frameID);
     void FrameBufferSwap();
+    
+    // Number of swaps that had to block because every buffer was still queued or on screen
+    int GetFlipStallCount();
+    
+    // Pace flips to 20, 30 or 60 Hz. 120 Hz needs an output mode the PS4 video out doesn't
+    // offer, so it (and anything else) returns false and keeps the current rate.
+    bool SetTargetFrameRate(int hz);
+    int GetTargetFrameRate();
+    
+    // Smoothed time between flips, and target intervals that passed without a new frame
+    uint32_t GetFrameTimeUsec();
+    int GetMissedVsyncCount();
+    
+    // Call when the app leaves the screen unchanged instead of drawing a frame, so the wait
+    // before the next queued frame's flip isn't counted as missed vsyncs
+    void SkipFrame();
+    
+#ifdef SCENE2D_HEADLESS
+    // Write every flipped frame to <prefix><frameID>.ppm/.png, a NULL prefix turns dumping off
+    void SetFrameDump(const char *prefix, ImageFileFormat format);
+#endif
+    
     void FrameBufferClear();
-    void FrameBufferClear(Color color);
-    void FrameBufferFill(Color color);
+    void FrameBufferClear(Pixel pixel);
+    void FrameBufferFill(Pixel pixel);
+    
+    // Every draw is clipped once against the clip rect and target when recorded, so any
+    // coordinates are safe and rasterising needs no per-pixel bounds checks
+    void DrawPixel(int x, int y, Pixel pixel);
+    void DrawRectangle(int x, int y, int w, int h, Pixel pixel);
+    void DrawGlyphRun(const BitmapFont *font, const char *text, int x, int y, int scale, Pixel pixel);
+    void DrawGlyphRun(const BitmapFont *font, const char *text, int length, int x, int y, int scale, Pixel pixel);
+    void DrawSprite(const uint32_t *pixels, int pitch, int srcWidth, int srcHeight, uint32_t contentID, int x, int y, int w, int h);
     
-    void DrawPixel(int x, int y, Color color);
-    void DrawRectangle(int x, int y, int w, int h, Color color);
+    // Interior and edges are opaque span fills, only the corner pixels are blended
+    void DrawRoundedRectangle(int x, int y, int w, int h, int radius, Pixel pixel);
+    
+    // Source-over variants, pixels carry premultiplied alpha
+    void DrawBlendedRectangle(int x, int y, int w, int h, Pixel pixel);
+    void DrawBlendedSprite(const uint32_t *pixels, int pitch, int srcWidth, int srcHeight, uint32_t contentID, int x, int y, int w, int h);
+    
+    // Unscaled surface blits of the whole surface or a source rect, drawn at x, y.
+    // The color key variant leaves the target alone where the source equals key.
+    void Blit(const Surface *src, int x, int y);
+    void Blit(const Surface *src, int srcX, int srcY, int w, int h, int x, int y);
+    void BlitColorKey(const Surface *src, int srcX, int srcY, int w, int h, int x, int y, Pixel key);
+    void BlitBlend(const Surface *src, int srcX, int srcY, int w, int h, int x, int y);
+    
+#ifdef GRAPHICS_USES_FONT
+    // FreeType text, UTF-8 with '\n' line breaks and y on the baseline. Glyphs are rendered once
+    // per (face, size, codepoint) into an LRU cache and blended from there.
+    bool InitFont(FT_Face *face, const char *fontPath, int fontSize);
+    void DrawText(const char *txt, FT_Face face, int size, int startX, int startY, Pixel pixel);
+#endif
 };
 
 #endif
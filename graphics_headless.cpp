@@ -0,0 +1,174 @@
+#ifdef SCENE2D_HEADLESS
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+#include <string>
+
+#include "graphics.h"
+#include "ImageWriter.h"
+#include "Timer.h"
+#include "log.h"
+
+// Host implementation of the platform half of Scene2D. Frame buffers live in anonymous
+// mappings, a flip completes as soon as it is submitted (there is no vsync to wait for)
+// and flipped frames can be written out as images for benchmarks and golden comparisons.
+
+bool Scene2D::Init(size_t memSize, int numFrameBuffers)
+{
+	// No video out handle, any non-zero value marks the scene as initialised
+	this->video = 1;
+	this->videoMem = NULL;
+	this->dumpFrames = false;
+	this->dumpFormat = IMAGE_FILE_PPM;
+	this->dumpPrefix[0] = '\0';
+	
+#ifdef GRAPHICS_USES_FONT
+	if (FT_Init_FreeType(&this->ftLib) != 0)
+	{
+		DEBUGLOG << "Failed to initialize freetype";
+		return false;
+	}
+#endif
+	
+	if(!allocateVideoMem(memSize, 0x200000))
+	{
+		DEBUGLOG << "Failed to allocate video memory: " << std::string(strerror(errno));
+		return false;
+	}
+	
+	if(!allocateFrameBuffers(numFrameBuffers))
+	{
+		DEBUGLOG << "Failed to allocate frame buffers";
+		return false;
+	}
+	
+	return true;
+}
+
+bool Scene2D::initFlipQueue()
+{
+	return true;
+}
+
+bool Scene2D::registerFrameBuffers()
+{
+	return true;
+}
+
+bool Scene2D::allocateVideoMem(size_t size, int alignment)
+{
+	// Align the allocation size
+	this->directMemAllocationSize = (size + alignment - 1) / alignment * alignment;
+	
+	this->videoMem = mmap(NULL, this->directMemAllocationSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	
+	if(this->videoMem == MAP_FAILED)
+	{
+		this->videoMem = NULL;
+		this->directMemAllocationSize = 0;
+		return false;
+	}
+	
+	// Set the stack pointer to the beginning of the buffer
+	this->videoMemSP = (uintptr_t)this->videoMem;
+	return true;
+}
+
+bool Scene2D::allocateSurfaceMem(size_t size)
+{
+	void *mem = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	
+	if(mem == MAP_FAILED)
+		return false;
+	
+	this->surfaceMem = (uint8_t *)mem;
+	this->surfaceMemSize = size;
+	return true;
+}
+
+void Scene2D::deallocateSurfaceMem()
+{
+	if(this->surfaceMem == NULL)
+		return;
+	
+	munmap(this->surfaceMem, this->surfaceMemSize);
+	this->surfaceMem = NULL;
+	this->surfaceMemSize = 0;
+	this->surfaceMemUsed = 0;
+}
+
+bool Scene2D::setFlipRate(int hz)
+{
+	// Nothing paces headless flips
+	(void)hz;
+	return true;
+}
+
+void Scene2D::deallocateVideoMem()
+{
+	if(this->videoMem)
+		munmap(this->videoMem, this->directMemAllocationSize);
+	
+	// Zero out meta data
+	this->videoMem = 0;
+	this->videoMemSP = 0;
+	this->directMemAllocationSize = 0;
+	
+	// Free the frame buffer array, no buffer carries a frame any more
+	delete[] this->frameBuffers;
+	this->frameBuffers = 0;
+	
+	for(int i = 0; i < SCENE2D_MAX_FRAME_BUFFERS; i++)
+		this->bufferFrameIDs[i] = -1;
+}
+
+void Scene2D::SetFrameDump(const char *prefix, ImageFileFormat format)
+{
+	this->dumpFrames = (prefix != NULL);
+	this->dumpFormat = format;
+	
+	if(prefix)
+		snprintf(this->dumpPrefix, sizeof(this->dumpPrefix), "%s", prefix);
+}
+
+void Scene2D::SubmitFlip(int bufferIndex, int frameID)
+{
+	if(this->dumpFrames)
+	{
+		char path[300];
+		snprintf(path, sizeof(path), "%s%06d.%s", this->dumpPrefix, frameID, this->dumpFormat == IMAGE_FILE_PNG ? "png" : "ppm");
+		
+		if(!WriteImage(path, (const uint32_t *)this->frameBuffers[bufferIndex], this->width, this->height, this->width, this->pixelFormat, this->dumpFormat))
+			DEBUGLOG << "Failed to write " << path;
+	}
+	
+	// The flip is done as soon as it is submitted
+	pthread_mutex_lock(&this->flipMutex);
+	if(frameID > this->lastFlipArg)
+		this->lastFlipArg = frameID;
+	recordFlip(this->lastFlipCount + 1, GetTimeUsec(), frameID);
+	pthread_cond_broadcast(&this->flipCond);
+	pthread_mutex_unlock(&this->flipMutex);
+}
+
+void Scene2D::FrameWait(int frameID)
+{
+	// Submitted flips have already completed
+	(void)frameID;
+}
+
+void Scene2D::updateFlipStatus()
+{
+}
+
+bool Scene2D::waitFlipEvent()
+{
+	// Nothing is ever pending, so there is no flip to wait for
+	return false;
+}
+
+#endif
@@ -0,0 +1,601 @@
+// Render regression check and throughput benchmark for the headless backend.
+//
+// Draws every screen from fixed inputs on an offscreen 1920x1080 scene set up like App::Init,
+// hashes each frame and compares it with the goldens below, then times whole screens and the
+// individual primitives. Build and run from the repository root:
+//
+//   g++ -O2 -std=c++11 -DSCENE2D_HEADLESS -I. -o render_bench tools/render_bench.cpp
+//       graphics.cpp graphics_headless.cpp DisplayList.cpp Blend.cpp WorkerPool.cpp
+//       GlyphCache.cpp ImageWriter.cpp Renderer.cpp Profiler.cpp Particles.cpp Theme.cpp
+//       TextLayout.cpp -lpthread
+//
+//   ./render_bench              check the goldens, then benchmark
+//   ./render_bench --check      check the goldens only
+//   ./render_bench --update     print a new golden table after an intended visual change
+//   ./render_bench --dump DIR   also write every screen to DIR/<name>.png for inspection
+//
+// Exits with 1 when a screen no longer matches its golden or renders differently with a
+// different number of raster threads, or when a vector blend kernel disagrees with its scalar
+// reference on random premultiplied pixels.
+
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "graphics.h"
+#include "Blend.h"
+#include "ImageWriter.h"
+#include "Renderer.h"
+
+std::stringstream debugLogStream;
+
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_SURFACE_MEM_SIZE (4 * 1920 * 1080 * 4)
+
+#define SCREEN_ITERATIONS 200
+#define PRIMITIVE_ROUNDS 20
+#define PRIMITIVE_BATCH 256
+
+#define BLEND_ROW_PIXELS 1920
+#define BLEND_ROWS 64           // Rows per pass, small enough to stay in cache
+#define BLEND_ROUNDS 50
+#define SPRITE_WIDTH 256
+#define SPRITE_HEIGHT 144
+
+// Board used by every game screen, covering small, large and empty cells
+static const int benchGrid[4][4] = {
+    {    2,    4,    8,   16 },
+    {   32,   64,  128,  256 },
+    {  512, 1024, 2048, 4096 },
+    {    0,    2,    0, 8192 }
+};
+
+static BoardMove benchMove;
+
+static void drawMenu(Scene2D* scene) {
+    Renderer::DrawMenu(scene, 0, 123456);
+}
+
+static void drawMenuSettings(Scene2D* scene) {
+    Renderer::DrawMenu(scene, 1, 0);
+}
+
+static void drawSettings(Scene2D* scene) {
+    Renderer::DrawSettings(scene, 0, 65, 0);
+}
+
+static void drawGame(Scene2D* scene) {
+    Renderer::DrawGame(scene, benchGrid, 20480, nullptr, 0);
+}
+
+// Halfway through the slide. Nothing merges, so no particles are spawned.
+static void drawGameSlide(Scene2D* scene) {
+    Renderer::DrawGame(scene, benchGrid, 20480, &benchMove, benchMove.startTime + TILE_SLIDE_USEC / 2);
+}
+
+static void drawGameProfiler(Scene2D* scene) {
+    ProfilerStats stats;
+    memset(&stats, 0, sizeof(stats));
+    for (int i = 0; i < PHASE_COUNT; i++) {
+        stats.phaseUsec[i] = 250 * (i + 1);
+    }
+    stats.fps = 60;
+    stats.worstFrameUsec = 17500;
+    
+    Renderer::DrawGame(scene, benchGrid, 20480, nullptr, 0);
+    Renderer::DrawProfiler(scene, stats);
+}
+
+static void drawGameWon(Scene2D* scene) {
+    Renderer::DrawGameOver(scene, benchGrid, 40960, 40960, true);
+}
+
+static void drawGameLost(Scene2D* scene) {
+    Renderer::DrawGameOver(scene, benchGrid, 20480, 40960, false);
+}
+
+struct BenchScreen {
+    const char* name;
+    void (*draw)(Scene2D* scene);
+};
+
+static const BenchScreen screens[] = {
+    { "menu",          drawMenu },
+    { "menu_settings", drawMenuSettings },
+    { "settings",      drawSettings },
+    { "game",          drawGame },
+    { "game_slide",    drawGameSlide },
+    { "game_profiler", drawGameProfiler },
+    { "game_won",      drawGameWon },
+    { "game_lost",     drawGameLost }
+};
+
+// FNV-1a of each screen's frame with the built-in classic theme, regenerate with --update
+struct BenchGolden {
+    const char* name;
+    uint64_t hash;
+};
+
+static const BenchGolden goldens[] = {
+    { "menu",          0x81649b599b2f5324ull },
+    { "menu_settings", 0xe8e46b8383eda75dull },
+    { "settings",      0x0b88eb4222b9040cull },
+    { "game",          0xa5985ce9104ef8abull },
+    { "game_slide",    0x9bdd1de6703cb547ull },
+    { "game_profiler", 0x03a83f2e07f0fbdbull },
+    { "game_won",      0xb4ebcaf32fa991a0ull },
+    { "game_lost",     0x2020d31a2b6e827bull }
+};
+
+#define SCREEN_COUNT (int)(sizeof(screens) / sizeof(screens[0]))
+#define GOLDEN_COUNT (int)(sizeof(goldens) / sizeof(goldens[0]))
+
+static uint32_t* framePixels;
+static int frameID;
+
+static uint64_t nowNsec() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Every tile has a motion, the bottom row has just slid right by one cell
+static void initMove() {
+    memset(&benchMove, 0, sizeof(benchMove));
+    
+    for (int row = 0; row < 4; row++) {
+        for (int col = 0; col < 4; col++) {
+            int value = benchGrid[row][col];
+            if (value == 0) continue;
+            
+            TileMotion* motion = &benchMove.motions[benchMove.motionCount++];
+            motion->fromRow = (int8_t)row;
+            motion->fromCol = (int8_t)(row == 3 ? col - 1 : col);
+            motion->toRow = (int8_t)row;
+            motion->toCol = (int8_t)col;
+            motion->value = value;
+            motion->merged = false;
+        }
+    }
+    
+    benchMove.spawnRow = -1;
+    benchMove.spawnCol = -1;
+    benchMove.startTime = 1000000;
+    benchMove.id = 1;
+}
+
+// Renderer keeps its sprites and layers in the scene's arena, so there is one scene for the
+// whole run and only its raster pool is resized
+static Scene2D* createScene() {
+    Scene2D* scene = new Scene2D(BENCH_WIDTH, BENCH_HEIGHT, 4);
+    
+    if (!scene->Init(0xC000000, 3)) {
+        printf("Failed to initialize 2D scene\n");
+        exit(2);
+    }
+    
+    scene->SetCacheableBackBuffer(true);
+    scene->InitSurfaceArena(BENCH_SURFACE_MEM_SIZE);
+    Renderer::Init(scene);
+    return scene;
+}
+
+// The same steps the render and present threads take for one frame
+static void presentFrame(Scene2D* scene, uint32_t* capture) {
+    frameID++;
+    scene->FlushDrawList();
+    int buffer = scene->QueueFrame(frameID);
+    if (capture) scene->CopyFrame(capture, BENCH_WIDTH);
+    scene->SubmitFlip(buffer, frameID);
+    scene->FrameWait(frameID);
+    scene->FrameBufferSwap();
+}
+
+static uint64_t renderAndHash(Scene2D* scene, const BenchScreen* screen) {
+    screen->draw(scene);
+    presentFrame(scene, framePixels);
+    
+    const uint8_t* bytes = (const uint8_t*)framePixels;
+    size_t size = (size_t)BENCH_WIDTH * BENCH_HEIGHT * sizeof(uint32_t);
+    uint64_t hash = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return hash;
+}
+
+// Every screen is hashed twice, the second time from cached layers and a back buffer that
+// already holds the frame. Both must agree.
+static bool hashScreens(Scene2D* scene, uint64_t* hashes) {
+    bool ok = true;
+    
+    for (int i = 0; i < SCREEN_COUNT; i++) {
+        scene->InvalidateFrame();
+        hashes[i] = renderAndHash(scene, &screens[i]);
+        
+        if (renderAndHash(scene, &screens[i]) != hashes[i]) {
+            printf("[FAIL] %s changes when redrawn from cached layers\n", screens[i].name);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static const BenchGolden* findGolden(const char* name) {
+    for (int i = 0; i < GOLDEN_COUNT; i++) {
+        if (strcmp(goldens[i].name, name) == 0) return &goldens[i];
+    }
+    return nullptr;
+}
+
+static void printGoldens(const uint64_t* hashes) {
+    printf("static const BenchGolden goldens[] = {\n");
+    for (int i = 0; i < SCREEN_COUNT; i++) {
+        int pad = 13 - (int)strlen(screens[i].name);
+        printf("    { \"%s\",%*s 0x%016llxull }%s\n", screens[i].name, pad, "",
+               (unsigned long long)hashes[i], i + 1 < SCREEN_COUNT ? "," : "");
+    }
+    printf("};\n");
+}
+
+static bool checkGoldens(const uint64_t* hashes) {
+    bool ok = true;
+    
+    for (int i = 0; i < SCREEN_COUNT; i++) {
+        const BenchGolden* golden = findGolden(screens[i].name);
+        bool match = golden && golden->hash == hashes[i];
+        
+        printf("[%s] %-14s 0x%016llx\n", match ? " OK " : "FAIL", screens[i].name, (unsigned long long)hashes[i]);
+        ok = ok && match;
+    }
+    return ok;
+}
+
+static void dumpScreens(Scene2D* scene, const char* dir) {
+    char path[256];
+    
+    for (int i = 0; i < SCREEN_COUNT; i++) {
+        renderAndHash(scene, &screens[i]);
+        snprintf(path, sizeof(path), "%s/%s.png", dir, screens[i].name);
+        
+        if (!WritePNG(path, framePixels, BENCH_WIDTH, BENCH_HEIGHT, BENCH_WIDTH, scene->GetPixelFormat())) {
+            printf("[ERROR] Failed to write %s\n", path);
+        }
+    }
+}
+
+// Cold frames resolve every band, steady frames repeat the screen so unchanged bands are
+// skipped the way they are while the game sits idle
+static void benchScreens(Scene2D* scene, int threads) {
+    printf("\n%d raster thread%s          cold us   steady us\n", threads, threads == 1 ? " " : "s");
+    
+    for (int i = 0; i < SCREEN_COUNT; i++) {
+        const BenchScreen* screen = &screens[i];
+        
+        uint64_t start = nowNsec();
+        for (int n = 0; n < SCREEN_ITERATIONS; n++) {
+            scene->InvalidateFrame();
+            screen->draw(scene);
+            presentFrame(scene, nullptr);
+        }
+        uint64_t cold = (nowNsec() - start) / SCREEN_ITERATIONS;
+        
+        start = nowNsec();
+        for (int n = 0; n < SCREEN_ITERATIONS; n++) {
+            screen->draw(scene);
+            presentFrame(scene, nullptr);
+        }
+        uint64_t steady = (nowNsec() - start) / SCREEN_ITERATIONS;
+        
+        printf("  %-22s %9.1f   %9.1f\n", screen->name, cold / 1000.0, steady / 1000.0);
+    }
+}
+
+static uint32_t randomState = 0x2545F491u;
+
+static uint32_t nextRandom() {
+    randomState ^= randomState << 13;
+    randomState ^= randomState >> 17;
+    randomState ^= randomState << 5;
+    return randomState;
+}
+
+// Premultiplied, so no channel exceeds alpha. Opaque and clear pixels come up often since
+// the vector paths treat them specially.
+static uint32_t randomPremultiplied() {
+    uint32_t r = nextRandom();
+    uint32_t alpha = (r & 3) == 0 ? 0 : (r & 3) == 1 ? 255 : (r >> 8) & 0xFF;
+    uint32_t pixel = alpha << 24;
+    
+    for (int shift = 0; shift < 24; shift += 8) {
+        pixel |= (nextRandom() % (alpha + 1)) << shift;
+    }
+    return pixel;
+}
+
+static void fillPremultiplied(uint32_t* pixels, int count) {
+    for (int i = 0; i < count; i++) {
+        pixels[i] = randomPremultiplied();
+    }
+}
+
+static uint32_t spritePixels[SPRITE_WIDTH * SPRITE_HEIGHT];
+
+// Each call queues item i of a batch and returns the pixels it covers
+static uint64_t primitiveRectangle(Scene2D* scene, int i) {
+    int w = 320, h = 180;
+    int x = (i * 97) % (BENCH_WIDTH - w);
+    int y = (i * 61) % (BENCH_HEIGHT - h);
+    scene->DrawRectangle(x, y, w, h, (Pixel)(0xFF000000u | (i * 0x010305u)));
+    return (uint64_t)w * h;
+}
+
+static uint64_t primitiveBlendedRectangle(Scene2D* scene, int i) {
+    int w = 320, h = 180;
+    int x = (i * 97) % (BENCH_WIDTH - w);
+    int y = (i * 61) % (BENCH_HEIGHT - h);
+    scene->DrawBlendedRectangle(x, y, w, h, (Pixel)(0x80000000u | ((i * 0x010305u) & 0x007F7F7Fu)));
+    return (uint64_t)w * h;
+}
+
+static uint64_t primitiveBlendedSprite(Scene2D* scene, int i) {
+    int x = (i * 97) % (BENCH_WIDTH - SPRITE_WIDTH);
+    int y = (i * 61) % (BENCH_HEIGHT - SPRITE_HEIGHT);
+    scene->DrawBlendedSprite(spritePixels, SPRITE_WIDTH, SPRITE_WIDTH, SPRITE_HEIGHT, 0x5EEDu,
+                             x, y, SPRITE_WIDTH, SPRITE_HEIGHT);
+    return (uint64_t)SPRITE_WIDTH * SPRITE_HEIGHT;
+}
+
+// Renderer's bitmap font has 5x5 glyphs on a 6 pixel advance, runs count their bounding box
+static uint64_t textArea(int length, int scale) {
+    return (uint64_t)(length * 6 - 1) * scale * 5 * scale;
+}
+
+static uint64_t primitiveText(Scene2D* scene, int i) {
+    static const char text[] = "THE QUICK BROWN FOX";
+    int scale = 4;
+    int x = (i * 53) % 1400;
+    int y = (i * 29) % (BENCH_HEIGHT - 5 * scale);
+    Renderer::DrawText(scene, text, x, y, 0xFFFFFFFF, scale, ALIGN_LEFT);
+    return textArea((int)strlen(text), scale);
+}
+
+static uint64_t primitiveNumber(Scene2D* scene, int i) {
+    int scale = 5;
+    int x = (i * 53) % 1600;
+    int y = (i * 29) % (BENCH_HEIGHT - 5 * scale);
+    Renderer::DrawNumber(scene, 1000000 + i * 7919, x, y, 0xFFFFFFFF, scale, ALIGN_LEFT);
+    return textArea(7, scale);
+}
+
+// Tiles are TILE_SIZE (Renderer.cpp) layout units across, which are pixels at 1920x1080
+static uint64_t primitiveTile(Scene2D* scene, int i) {
+    static const int values[] = { 2, 16, 128, 1024, 2048, 8192 };
+    Renderer::DrawTile(scene, (i / 4) % 4, i % 4, values[i % 6]);
+    return 150ull * 150ull;
+}
+
+struct BenchPrimitive {
+    const char* name;
+    uint64_t (*draw)(Scene2D* scene, int i);
+};
+
+static const BenchPrimitive primitives[] = {
+    { "DrawRectangle", primitiveRectangle },
+    { "BlendedRect",   primitiveBlendedRectangle },
+    { "BlendedSprite", primitiveBlendedSprite },
+    { "DrawText",      primitiveText },
+    { "DrawNumber",    primitiveNumber },
+    { "DrawTile",      primitiveTile }
+};
+
+// Times recording and rasterising a batch, the frame is cleared and flushed beforehand so
+// neither the clear nor band skipping is counted
+static void benchPrimitives(Scene2D* scene) {
+    printf("\nprimitive        ns/call   Mpix/s\n");
+    
+    for (size_t p = 0; p < sizeof(primitives) / sizeof(primitives[0]); p++) {
+        uint64_t pixels = 0;
+        uint64_t elapsed = 0;
+        
+        for (int round = 0; round < PRIMITIVE_ROUNDS; round++) {
+            scene->InvalidateFrame();
+            scene->FrameBufferFill(0xFF000000);
+            scene->FlushDrawList();
+            
+            uint64_t start = nowNsec();
+            for (int i = 0; i < PRIMITIVE_BATCH; i++) {
+                pixels += primitives[p].draw(scene, i);
+            }
+            scene->FlushDrawList();
+            elapsed += nowNsec() - start;
+            
+            presentFrame(scene, nullptr);
+        }
+        
+        double calls = (double)PRIMITIVE_ROUNDS * PRIMITIVE_BATCH;
+        printf("  %-14s %7.1f %8.1f\n", primitives[p].name, elapsed / calls, pixels * 1000.0 / elapsed);
+    }
+}
+
+// The vector kernels behind blended rects, sprites and color keyed blits next to their
+// scalar references, which take the same arguments through these wrappers
+typedef void (*BlendKernel)(uint32_t* dst, const uint32_t* src, int count, Pixel pixel);
+
+static void spanVector(uint32_t* dst, const uint32_t*, int count, Pixel pixel) { BlendSpan(dst, count, pixel); }
+static void spanScalar(uint32_t* dst, const uint32_t*, int count, Pixel pixel) { BlendSpanScalar(dst, count, pixel); }
+static void rowVector(uint32_t* dst, const uint32_t* src, int count, Pixel) { BlendRow(dst, src, count); }
+static void rowScalar(uint32_t* dst, const uint32_t* src, int count, Pixel) { BlendRowScalar(dst, src, count); }
+static void keyVector(uint32_t* dst, const uint32_t* src, int count, Pixel key) { ColorKeyRow(dst, src, count, key); }
+static void keyScalar(uint32_t* dst, const uint32_t* src, int count, Pixel key) { ColorKeyRowScalar(dst, src, count, key); }
+
+struct BenchBlend {
+    const char* name;
+    BlendKernel vector;
+    BlendKernel scalar;
+};
+
+static const BenchBlend blends[] = {
+    { "BlendSpan",   spanVector, spanScalar },
+    { "BlendRow",    rowVector,  rowScalar },
+    { "ColorKeyRow", keyVector,  keyScalar }
+};
+
+#define BLEND_COUNT (int)(sizeof(blends) / sizeof(blends[0]))
+
+// Color key sources repeat the key often enough to exercise both sides of the select
+static Pixel prepareSource(uint32_t* src, int count) {
+    Pixel key = randomPremultiplied();
+    fillPremultiplied(src, count);
+    
+    for (int i = 0; i < count; i++) {
+        if (nextRandom() % 3 == 0) src[i] = key;
+    }
+    return key;
+}
+
+// Every alignment and short length the vector heads and tails handle, then full rows
+static bool checkBlends() {
+    uint32_t src[BLEND_ROW_PIXELS + 4];
+    uint32_t expected[BLEND_ROW_PIXELS + 4];
+    uint32_t actual[BLEND_ROW_PIXELS + 4];
+    bool ok = true;
+    
+    for (int b = 0; b < BLEND_COUNT; b++) {
+        int mismatches = 0;
+        
+        for (int trial = 0; trial < 2000; trial++) {
+            int offset = trial & 3;
+            int count = trial < 1600 ? trial % 80 : BLEND_ROW_PIXELS;
+            
+            Pixel pixel = prepareSource(src, BLEND_ROW_PIXELS + 4);
+            fillPremultiplied(expected, BLEND_ROW_PIXELS + 4);
+            memcpy(actual, expected, sizeof(actual));
+            
+            blends[b].scalar(expected + offset, src + ((trial >> 2) & 3), count, pixel);
+            blends[b].vector(actual + offset, src + ((trial >> 2) & 3), count, pixel);
+            
+            if (memcmp(expected, actual, sizeof(actual)) != 0) mismatches++;
+        }
+        
+        if (mismatches) {
+            printf("[FAIL] %s differs from its scalar reference in %d of 2000 runs\n", blends[b].name, mismatches);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static void benchBlends() {
+    int pixels = BLEND_ROW_PIXELS * BLEND_ROWS;
+    uint32_t* src = (uint32_t*)malloc(pixels * sizeof(uint32_t));
+    uint32_t* dst = (uint32_t*)malloc(pixels * sizeof(uint32_t));
+    
+#if defined(__SSE2__)
+    printf("\nkernel         SSE2 Mpix/s   scalar Mpix/s\n");
+#else
+    printf("\nkernel       vector Mpix/s   scalar Mpix/s   (no SSE2, both scalar)\n");
+#endif
+    
+    for (int b = 0; b < BLEND_COUNT; b++) {
+        BlendKernel kernels[2] = { blends[b].vector, blends[b].scalar };
+        double rate[2];
+        
+        // A translucent span color, opaque and clear ones would take the shortcuts
+        Pixel pixel = prepareSource(src, pixels);
+        if (blends[b].vector == spanVector) pixel = 0x80402010u;
+        
+        for (int k = 0; k < 2; k++) {
+            fillPremultiplied(dst, pixels);
+            
+            uint64_t start = nowNsec();
+            for (int round = 0; round < BLEND_ROUNDS; round++) {
+                for (int row = 0; row < BLEND_ROWS; row++) {
+                    int at = row * BLEND_ROW_PIXELS;
+                    kernels[k](dst + at, src + at, BLEND_ROW_PIXELS, pixel);
+                }
+            }
+            uint64_t elapsed = nowNsec() - start;
+            rate[k] = (double)pixels * BLEND_ROUNDS * 1000.0 / elapsed;
+        }
+        
+        printf("  %-12s %13.1f %15.1f\n", blends[b].name, rate[0], rate[1]);
+    }
+    
+    free(src);
+    free(dst);
+}
+
+int main(int argc, char** argv) {
+    bool update = false;
+    bool checkOnly = false;
+    const char* dumpDir = nullptr;
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--update") == 0) {
+            update = true;
+        } else if (strcmp(argv[i], "--check") == 0) {
+            checkOnly = true;
+        } else if (strcmp(argv[i], "--dump") == 0 && i + 1 < argc) {
+            dumpDir = argv[++i];
+        } else {
+            printf("Usage: %s [--check] [--update] [--dump DIR]\n", argv[0]);
+            return 2;
+        }
+    }
+    
+    // 1, 2, 4 and every core, when there are more than 4
+    int cores = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    int threadCounts[4] = { 1, 2, 4, cores };
+    int threadCountCount = cores > 4 ? 4 : 3;
+    
+    initMove();
+    fillPremultiplied(spritePixels, SPRITE_WIDTH * SPRITE_HEIGHT);
+    framePixels = (uint32_t*)malloc((size_t)BENCH_WIDTH * BENCH_HEIGHT * sizeof(uint32_t));
+    Scene2D* scene = createScene();
+    
+    // Output may not depend on how the frame is split into bands
+    uint64_t reference[SCREEN_COUNT];
+    bool ok = true;
+    
+    for (int t = 0; t < threadCountCount; t++) {
+        uint64_t hashes[SCREEN_COUNT];
+        scene->SetRasterThreads(threadCounts[t]);
+        ok = hashScreens(scene, hashes) && ok;
+        
+        for (int i = 0; i < SCREEN_COUNT; i++) {
+            if (t == 0) {
+                reference[i] = hashes[i];
+            } else if (hashes[i] != reference[i]) {
+                printf("[FAIL] %s differs with %d raster threads\n", screens[i].name, threadCounts[t]);
+                ok = false;
+            }
+        }
+    }
+    
+    if (update) {
+        printGoldens(reference);
+    } else {
+        ok = checkBlends() && ok;
+        ok = checkGoldens(reference) && ok;
+        printf("%s\n", ok ? "Goldens match" : "Render regression detected");
+    }
+    
+    if (dumpDir) dumpScreens(scene, dumpDir);
+    
+    if (!update && !checkOnly) {
+        for (int t = 0; t < threadCountCount; t++) {
+            scene->SetRasterThreads(threadCounts[t]);
+            benchScreens(scene, threadCounts[t]);
+        }
+        benchPrimitives(scene);
+        benchBlends();
+    }
+    
+    delete scene;
+    free(framePixels);
+    return ok ? 0 : 1;
+}